@@ -60,6 +60,7 @@ void hal_pin_busy_wait (void);
 #define HAL_IRQMASK_DIO1 (1<<1)
 #define HAL_IRQMASK_DIO2 (1<<2)
 #define HAL_IRQMASK_DIO3 (1<<3)
+#define HAL_IRQMASK_FAST (1<<7) // interrupts must be serviced with low latency (no deep sleep)
 void hal_irqmask_set (int mask);
 
 #if defined(BRD_sx1261_radio) || defined(BRD_sx1262_radio)
@@ -132,6 +133,13 @@ s2_t hal_subticks (void);
  */
 void hal_waitUntil (u4_t time);
 
+/*
+ * call func at specified timestamp with interrupts disabled (right away if it
+ * has passed), sleeping instead of busy-waiting until then.
+ * only one call can be pending, func == NULL cancels it.
+ */
+void hal_timedCall (u4_t time, void (*func) (void));
+
 /*
  * get current battery level
  */
@@ -161,6 +169,8 @@ typedef struct {
     uint32_t version;
     uint32_t crc;
     uint32_t flashsz;
+    const void* base;       // start of running firmware image
+    uint32_t size;          // size of running firmware image
 } hal_fwi;
 
 void hal_fwinfo (hal_fwi* fwi);
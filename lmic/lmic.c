@@ -189,6 +189,31 @@ static const u1_t DR2RPS_IN[16] = {
     ILLEGAL_RPS,                 ILLEGAL_RPS,                 ILLEGAL_RPS,                 ILLEGAL_RPS,
 };
 #endif
+// band tables (regions with dynamic channels)
+#ifdef CFG_eu868
+static const band_t BANDS_EU868[] = {
+    { BAND_FREQ(869400000), BAND_FREQ(869650000), CAP_DECI,  29 }, // h1.7
+    { BAND_FREQ(865000000), BAND_FREQ(868000000), CAP_CENTI, 16 }, // h1.4
+    { BAND_FREQ(868000000), BAND_FREQ(868600000), CAP_CENTI, 16 }, // h1.5
+    { BAND_FREQ(869700000), BAND_FREQ(870000000), CAP_CENTI, 16 }, // h1.9
+    { BAND_FREQ(862000000), BAND_FREQ(863000000), CAP_MILLI, 16 }, // h0, max 350kHz BW (not enforced)
+    { BAND_FREQ(863000000), BAND_FREQ(865000000), CAP_MILLI, 16 }, // h1.3
+    { BAND_FREQ(868700000), BAND_FREQ(869200000), CAP_MILLI, 16 }, // h1.6
+};
+LMIC_STATIC_ASSERT(sizeof(BANDS_EU868) / sizeof(band_t) <= MAX_BANDS, "too many bands");
+#endif
+#ifdef CFG_as923
+static const band_t BANDS_AS923[] = {
+    { 0, 0, CAP_NONE,  16 }, // ==> no bands (XXX:bit of a hack)
+};
+#endif
+#ifdef CFG_in865
+static const band_t BANDS_IN865[] = {
+    { BAND_FREQ(865000000), BAND_FREQ(867000000), CAP_NONE, 30 }
+};
+#endif
+#define BANDS(b) .bands = b, .numBands = sizeof(b) / sizeof(band_t)
+
 #ifdef REG_DYN
 static const rfuncs_t RFUNCS_DYN;  // fwd decl
 #endif
@@ -203,6 +228,10 @@ static const rfuncs_t RFUNCS_FIX;  // fwd decl
             __RX1DRval(dnoff,d4), __RX1DRval(dnoff,d5),         \
             __RX1DRval(dnoff,d6), __RX1DRval(dnoff,d7) }
 
+// XXX: region definitions are hand-written - generating them from
+// tools/pylora/loradefs.py is left for a follow-up (lmic/test/chtest.py checks
+// the fixed channel plans against it). rx1DrOff and dr2maxAppPload stay inline:
+// unlike dr2rps hardly any two regions share them, so pointers would not save flash.
 static const region_t REGIONS[REGIONS_COUNT] = {
 #ifdef CFG_eu868
     [REGION_EU868] = {
@@ -217,15 +246,7 @@ static const region_t REGIONS[REGIONS_COUNT] = {
         .ccaThreshold   = (-80 + RSSI_OFF), // -80dBm XXX
         .ccaTime        = us2osticks(160),
 #endif
-        .bands          = {
-            { 869400000, 869650000, CAP_DECI,  29 }, // h1.7
-            { 865000000, 868000000, CAP_CENTI, 16 }, // h1.4
-            { 868000000, 868600000, CAP_CENTI, 16 }, // h1.5
-            { 869700000, 870000000, CAP_CENTI, 16 }, // h1.9
-            { 862000000, 863000000, CAP_MILLI, 16 }, // h0, max 350kHz BW (not enforced)
-            { 863000000, 865000000, CAP_MILLI, 16 }, // h1.3
-            { 868700000, 869200000, CAP_MILLI, 16 }, // h1.6
-        },
+        BANDS(BANDS_EU868),
         .beaconFreq     = 869525000,
         .rx2Freq        = 869525000,
         .pingFreq       = 869525000,
@@ -252,9 +273,7 @@ static const region_t REGIONS[REGIONS_COUNT] = {
         .maxFreq        = 928000000,
         .defaultCh      = { 923200000, 923400000 },
         .chTxCap        = 10, // 10%
-        .bands          = {
-            { 0, 0, CAP_NONE,  16 }, // ==> no bands (XXX:bit of a hack)
-        },
+        BANDS(BANDS_AS923),
         .beaconFreq     = 923400000,
         .rx2Freq        = 923200000,
         .pingFreq       = 923400000,
@@ -333,7 +352,7 @@ static const region_t REGIONS[REGIONS_COUNT] = {
         .flags          = REG_FIXED,
         .minFreq        = 470000000,
         .maxFreq        = 510000000,
-        .baseFreq125    = 470200000,
+        .baseFreq125    = 470300000,
         .baseFreqFix    = 0,
         .baseFreqDn     = 500300000,
         .numChBlocks    = 12,
@@ -345,7 +364,7 @@ static const region_t REGIONS[REGIONS_COUNT] = {
         .beaconOffInfo  = 9,
         .beaconLen      = 19,
         .beaconAirtime  = us2osticksRound(305152),
-        .maxEirp        = 30,
+        .maxEirp        = 19,
         .fixDr          = ILLEGAL_DR,
         .rx1DrOff       = RX1DR_OFFSETS(0,  0, 1, 2, 3, 4,
                                         ILLEGAL_RX1DRoff, ILLEGAL_RX1DRoff, ILLEGAL_RX1DRoff),
@@ -361,9 +380,7 @@ static const region_t REGIONS[REGIONS_COUNT] = {
         .minFreq        = 865000000,
         .maxFreq        = 867000000,
         .defaultCh      = { 865062500, 865402500, 865985000 },
-        .bands          = {
-            { 865000000, 867000000, CAP_NONE, 30 }
-        },
+        BANDS(BANDS_IN865),
         .beaconFreq     = 866550000,
         .rx2Freq        = 866550000,
         .pingFreq       = 866550000,
@@ -433,8 +450,9 @@ static void setAvail (avail_t* pavail, osxtime_t t) {
             for( int i = 0; i < MAX_DYN_CHNLS; i++ ) {
                 adjAvail(&LMIC.dyn.chAvail[i], base);
             }
-            for( int i=0; i < MAX_BANDS && REGION.bands[i].lo; i++ ) {
+            for( int i=0; i < MAX_BANDS; i++ ) {
                 adjAvail(&LMIC.dyn.bandAvail[i], base);
+                adjAvail(&LMIC.dyn.bandChAvail[i], base);
             }
         }
 #endif
@@ -626,7 +644,8 @@ static ostime_t calcRxWindow (u1_t secs, dr_t dr) {
     // rxoff is the center of the beacon preamble adjusted by drift
     // rxsyms is the width of the rx window
     // limit for dr2hsym/rxsym: s1_t
-    return rxoff - dr2hsym(dr, rxsyms>127 ? 127 : rxsyms);
+    LMIC.rxsyms = rxsyms>127 ? 127 : rxsyms;
+    return rxoff - dr2hsym(dr, LMIC.rxsyms);
 }
 
 
@@ -704,44 +723,82 @@ static void adjustByRxdErr (u1_t rxdelay, u1_t dr) {
 
 
 #if !defined(DISABLE_CLASSB)
-// Setup scheduled RX window (ping/multicast slot)
-static void rxschedInit (rxsched_t* rxsched) {
+// Set start of RX window of current slot - only the drift is applied per
+// slot, everything else has been precomputed for the beacon period
+static void rxschedSlot (rxsched_t* rxsched) {
+    ostime_t secs = /*BCN_RESERVE*/2 + rxsched->slot + (1 << (rxsched->intvExp & 0x7));
+    rxsched->rxtime = rxsched->rxbase
+        + ((BCN_WINDOW_osticks * (ostime_t)rxsched->slot) >> BCN_INTV_exp)
+        + ((LMIC.drift * secs) >> BCN_INTV_exp);
+}
+
+// Setup scheduled RX window (ping/multicast slot) for current beacon period
+static void rxschedInit (rxsched_t* rxsched, devaddr_t addr) {
     // Relates to the standard in the following way:
     //   pingNb = 2^(7-intvExp)
     //   pingOffset = Rand % pingPeriod
     //   pingPeriod = 2^12 / pingNb = 2^12 / 2^(7-intvExp) = 2^5/2^-intvExp = 32<<intvExp
-    ASSERT((LMIC.opmode & OP_PINGABLE) && rxsched->intvExp <= 7);
+    ASSERT(rxsched->intvExp <= 7);
     u1_t intvExp = rxsched->intvExp;
     os_clearMem(LMIC.frame+8,8);
     os_wlsbf4(LMIC.frame, LMIC.bcninfo.time);
-    os_wlsbf4(LMIC.frame+4, LMIC.devaddr);
+    os_wlsbf4(LMIC.frame+4, addr);
     lce_encKey0(LMIC.frame);
     ostime_t off = os_rlsbf2(LMIC.frame) & ((32<<intvExp)-1); // random offset (slot units)
+    // Size window for the last slot of the period (widest drift error) and
+    // use it for all slots - saves calcRxWindow per slot
+    calcRxWindow(/*secs BCN_RESERVE*/2+BCN_INTV_sec, rxsched->dr);
+    rxsched->rxsyms = LMIC.rxsyms;
     rxsched->rxbase = (LMIC.bcninfo.txtime +
                        BCN_RESERVE_osticks +
-                       ms2osticks(BCN_SLOT_SPAN_ms * off)); // random offset osticks
+                       ms2osticks(BCN_SLOT_SPAN_ms * off) + // random offset osticks
+                       dr2hsym(rxsched->dr, PAMBL_SYMS) -
+                       dr2hsym(rxsched->dr, rxsched->rxsyms));
     rxsched->slot   = 0;
-    rxsched->rxtime = rxsched->rxbase + calcRxWindow(/*secs BCN_RESERVE*/2+(1<<intvExp),rxsched->dr);
-    rxsched->rxsyms = LMIC.rxsyms;
+    rxschedSlot(rxsched);
 }
 
 
 static bit_t rxschedNext (rxsched_t* rxsched, ostime_t cando) {
-  again:
-    if( rxsched->rxtime - cando >= 0 )
-        return 1;
     u1_t slot;
+  again:
+    // check slot first - rxtime is stale if nothing is scheduled
     if( (slot=rxsched->slot) >= 128 )
         return 0;
+    if( rxsched->rxtime - cando >= 0 )
+        return 1;
     u1_t intv = 1<<(rxsched->intvExp & 0x7);
     if( (rxsched->slot = (slot += (intv))) >= 128 )
         return 0;
-    rxsched->rxtime = rxsched->rxbase
-        + ((BCN_WINDOW_osticks * (ostime_t)slot) >> BCN_INTV_exp)
-        + calcRxWindow(/*secs BCN_RESERVE*/2+slot+intv,rxsched->dr);
-    rxsched->rxsyms = LMIC.rxsyms;
+    rxschedSlot(rxsched);
     goto again;
 }
+
+// Setup schedules of all class B multicast groups for current beacon period
+static void rxschedInitMcast (void) {
+    for( session_t* s = LMIC.sessions; s < LMIC.sessions+MAX_MULTICAST_SESSIONS; s++ ) {
+        if( s->mode == MC_CLASS_B ) {
+            rxschedInit(&s->ping, s->grpaddr);  // note: reuses LMIC.frame buffer!
+        }
+    }
+}
+
+// Pick earliest slot not before cando across unicast and all multicast groups.
+// Slots of several schedules at the same time, frequency and data rate are
+// served by a single RX (frames are dispatched by address), otherwise the
+// earliest slot wins (unicast on a tie) and overlapped slots are skipped.
+static rxsched_t* rxschedPick (ostime_t cando) {
+    rxsched_t* next = NULL;
+    if( (LMIC.opmode & OP_PINGINI) != 0 && rxschedNext(&LMIC.ping, cando) )
+        next = &LMIC.ping;
+    for( session_t* s = LMIC.sessions; s < LMIC.sessions+MAX_MULTICAST_SESSIONS; s++ ) {
+        if( s->mode == MC_CLASS_B && rxschedNext(&s->ping, cando)
+                && (next == NULL || s->ping.rxtime - next->rxtime < 0) ) {
+            next = &s->ping;
+        }
+    }
+    return next;
+}
 #endif
 
 
@@ -831,6 +888,27 @@ static dr_t prepareDnDr (dr_t updr) {
     return dndr;
 }
 
+// Shard between REG_DYN/REG_FIX
+// listen before talk on LMIC.freq/LMIC.rps (rssi - regional RSSI based CCA required)
+// return: 1 - channel is busy, 0 - channel is clear
+static bit_t lbtBusy (bit_t rssi) {
+    if( rssi ) {
+        LMIC.rxtime = REGION.ccaTime;
+        LMIC.rssi = REGION.ccaThreshold;
+        os_radio(RADIO_CCA);
+        if( LMIC.rssi >= REGION.ccaThreshold ) {
+            return 1;
+        }
+    }
+    if( (LMIC.cadMode & CAD_LBT) && isLora(LMIC.rps) ) {
+        os_radio(RADIO_CCACAD);
+        if( LMIC.rssi == CAD_RSSI_BUSY ) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 // ================================================================================
 // BEG DYNAMIC CHANNEL PLAN REGIONS
 
@@ -844,10 +922,30 @@ static void prepareDn_dyn () {
     }
 }
 
+// (re-)enter channel into the per-DR and per-band selection index
+static void indexChannel_dyn (u1_t chidx, drmap_t drmap, u1_t band) {
+    u2_t chnlbit = 1 << chidx;
+    for( u1_t dr = 0; dr < 16; dr++ ) {
+        if( drmap & (1 << dr) ) {
+            LMIC.dyn.drChnls[dr] |= chnlbit;
+        } else {
+            LMIC.dyn.drChnls[dr] &= ~chnlbit;
+        }
+    }
+    for( u1_t b = 0; b < MAX_BANDS; b++ ) {
+        LMIC.dyn.bandChnls[b] &= ~chnlbit;
+    }
+    if( drmap ) {
+        LMIC.dyn.bandChnls[band] |= chnlbit;
+    }
+    LMIC.dyn.chBusy &= ~chnlbit;
+}
+
 static void disableChannel_dyn (u1_t chidx) {
     LMIC.dyn.chUpFreq[chidx] = 0;
     LMIC.dyn.chDnFreq[chidx] = 0;
     LMIC.dyn.chDrMap [chidx] = 0;
+    indexChannel_dyn(chidx, 0, 0);
     LMIC.dyn.channelMap &= ~(1 << chidx);
     if (LMIC.dyn.channelMap == 0) {
         LMIC.dyn.channelMap = (1 << MIN_DYN_CHNLS) - 1; // safety net
@@ -880,10 +978,10 @@ static bit_t setupChannel_dyn (u1_t chidx, freq_t freq, drmap_t drmap) {
     freq &= ~BAND_MASK;
     if( REGION.bands[0].lo ) {
         // Region has bands - freq must fall within one (currently EU868 only)
-        for (u1_t i = 0; i < MAX_BANDS; i++) {
+        for (u1_t i = 0; i < REGION.numBands; i++) {
             const band_t* b = &REGION.bands[i];
             // XXX:TODO: take bandwidth into account when checking frequencies
-            if (freq >= b->lo && freq <= b->hi) {
+            if (freq >= (freq_t) b->lo * BAND_FREQ_UNIT && freq <= (freq_t) b->hi * BAND_FREQ_UNIT) {
                 freq |= i;
                 goto ok;
             }
@@ -895,6 +993,7 @@ static bit_t setupChannel_dyn (u1_t chidx, freq_t freq, drmap_t drmap) {
     LMIC.dyn.chUpFreq[chidx] = freq;
     LMIC.dyn.chDnFreq[chidx] = 0;               // reset DN freq if channel is setup/modified
     LMIC.dyn.chDrMap[chidx] = drmap ?: all125up();
+    indexChannel_dyn(chidx, LMIC.dyn.chDrMap[chidx], freq & BAND_MASK);
     setAvail(&LMIC.dyn.chAvail[chidx], 0);      // available right away
     LMIC.dyn.channelMap |= 1 << chidx;          // enabled right away
     return 1;
@@ -937,9 +1036,9 @@ static u1_t checkChannelMap_dyn (u2_t* map) {
 
 static void syncDatarate_dyn (void) {
     drmap_t endrs = 0;  // enabled data rates
-    for (u1_t ci = 0; ci < MAX_DYN_CHNLS; ci++) {
-        if (LMIC.dyn.channelMap & (1 << ci)) {
-            endrs |= LMIC.dyn.chDrMap[ci];
+    for (u1_t dr = 0; dr < 16; dr++) {
+        if (LMIC.dyn.drChnls[dr] & LMIC.dyn.channelMap) {
+            endrs |= 1 << dr;
         }
     }
     ASSERT(endrs != 0);
@@ -981,6 +1080,14 @@ static void updateTx_dyn (ostime_t txbeg) {
     setAvail(&LMIC.dyn.chAvail[LMIC.txChnl], os_time2XTime(txbeg +
                 airtime * REGION.chTxCap,
                 xnow));
+    if( REGION.chTxCap ) {
+        // Keep band minimum a lower bound of all blocked channels in band
+        if( (LMIC.dyn.chBusy & LMIC.dyn.bandChnls[b]) == 0
+                || LMIC.dyn.chAvail[LMIC.txChnl] < LMIC.dyn.bandChAvail[b] ) {
+            LMIC.dyn.bandChAvail[b] = LMIC.dyn.chAvail[LMIC.txChnl];
+        }
+        LMIC.dyn.chBusy |= 1 << LMIC.txChnl;
+    }
     // Update global duty cycle stats
     if (LMIC.globalDutyRate != 0) {
         LMIC.globalDutyAvail = txbeg + (airtime << LMIC.globalDutyRate);
@@ -991,23 +1098,33 @@ static void updateTx_dyn (ostime_t txbeg) {
 }
 
 static u1_t selectRandomChnl (u2_t map, u1_t nbits) {
-    u1_t k;
- again:
+    if( nbits > 1 && LMIC.refChnl < MAX_DYN_CHNLS && (map & (1 << LMIC.refChnl)) ) {
+        map &= ~(1 << LMIC.refChnl); // don't use same channel twice
+        nbits -= 1;
+    }
     // Note: we have a small negligible bias of 2^16 % nbits (nbits <= 16 => bias < 0.025%)
-    k = os_getRndU2() % nbits;
-    for( u1_t chnl=0; chnl<16; chnl++ ) {
-        if( (map & (1<<chnl)) == 0 )
-            continue;
-        if( k==0 ) {
-            if( LMIC.refChnl == chnl && nbits > 1 )
-                goto again; // don't use same channel twice
-            LMIC.refChnl = chnl;
-            return chnl;
+    for( u1_t k = os_getRndU2() % nbits; k > 0; k-- ) {
+        map &= map - 1; // drop lowest candidate
+    }
+    ASSERT(map != 0);
+    return LMIC.refChnl = __builtin_ctz(map);
+}
+
+// Drop channels from busy set whose per-channel DC has expired
+// and recompute earliest expiry of remaining blocked channels in band.
+static void refreshBandBusy_dyn (u1_t b, osxtime_t xnow) {
+    u2_t busy = LMIC.dyn.chBusy & LMIC.dyn.bandChnls[b];
+    avail_t min = 0xffff;
+    while( busy ) {
+        u1_t chnl = __builtin_ctz(busy);
+        busy &= busy - 1;
+        if( getAvail(LMIC.dyn.chAvail[chnl]) <= xnow ) {
+            LMIC.dyn.chBusy &= ~(1 << chnl);
+        } else if( LMIC.dyn.chAvail[chnl] < min ) {
+            min = LMIC.dyn.chAvail[chnl];
         }
-        k--;
     }
-    ASSERT(0);
-    return 0;
+    LMIC.dyn.bandChAvail[b] = min;
 }
 
 // select channel, perform LBT if required
@@ -1015,73 +1132,77 @@ static u1_t selectRandomChnl (u2_t map, u1_t nbits) {
 // when to try again (no free channel or DC).
 // will block while doing LBT
 static ostime_t nextTx_dyn (ostime_t now) {
-    drmap_t drbit = 1 << LMIC.datarate;
     osxtime_t xnow = os_time2XTime(now, os_getXTime());
     osxtime_t txavail = OSXTIME_MAX;
-    u1_t cccnt = 0; // number of candidate channels
     u2_t ccmap = 0; // candidate channel mask
     u2_t pcmap = 0; // probe channel mask
+    u2_t enmap;     // enabled channels for current datarate
 again:
-    for (u1_t chnl = 0; chnl < MAX_DYN_CHNLS; chnl++) {
-        u2_t chnlbit = 1 << chnl;
-        if ((LMIC.dyn.channelMap & chnlbit) == 0 ||             // channel disabled
-                (LMIC.dyn.chDrMap[chnl] & drbit) == 0) {        // or not enabled for current datarate
-            continue;
-        }
-        // check channel DC availability
-        osxtime_t avail = getAvail(LMIC.dyn.chAvail[chnl]);
-        // check band DC availability
-        osxtime_t bavail = getAvail(LMIC.dyn.bandAvail[LMIC.dyn.chUpFreq[chnl] & BAND_MASK]);
-        debug_verbose_printf("Considering channel %u, available at %t (in band %u available at %t)\r\n", chnl, (ostime_t)avail, LMIC.dyn.chUpFreq[chnl] & BAND_MASK, (ostime_t)bavail);
-        if( LMIC.noDC )
-            goto addch;
-        if (REGION.flags & REG_PSA ) {
-            // PSA: channel can be used if band DC (unconditional)
-            // or channel DC (PSA) are available
-            if( bavail <= xnow ) {
-                avail = bavail;  // just use the channel without probe
-            } else {
-                pcmap |= chnlbit; // if PSA DC permits then probe this channel
-            }
-        } else {
-            // do not use channel unless both band+channel DC are available
-            if (bavail > avail) {
-                avail = bavail;
-            }
-        }
-        if( avail <= xnow ) {
-          addch:
-            cccnt += 1;
-            ccmap |= chnlbit;
-        }
-        if( txavail > avail ) {
-            txavail = avail;
-        }
-    }
-    if (txavail == OSXTIME_MAX) {
+    enmap = LMIC.dyn.drChnls[LMIC.datarate] & LMIC.dyn.channelMap;
+    if( enmap == 0 ) {
         debug_verbose_printf("No suitable channel found, trying different datarate\r\n");
         // No suitable channel found - maybe there's no channel which includes current datarate
+        dr_t dr = LMIC.datarate;
         syncDatarate();
-        drmap_t drbit2 = 1 << LMIC.datarate;
-        ASSERT(drbit != drbit2);
-        drbit = drbit2;
+        ASSERT(dr != LMIC.datarate);
         goto again;
     }
+    if( LMIC.noDC ) {
+        ccmap = enmap;
+        txavail = xnow;
+    } else {
+        for( u1_t b = 0; b < MAX_BANDS; b++ ) {
+            u2_t bcmap = enmap & LMIC.dyn.bandChnls[b];
+            if( bcmap == 0 ) {
+                continue;
+            }
+            // check band DC availability
+            osxtime_t bavail = getAvail(LMIC.dyn.bandAvail[b]);
+            // check channel DC availability (earliest channel in band)
+            if( (bcmap & LMIC.dyn.chBusy) && getAvail(LMIC.dyn.bandChAvail[b]) <= xnow ) {
+                refreshBandBusy_dyn(b, xnow);
+            }
+            u2_t chfree = bcmap & ~LMIC.dyn.chBusy;
+            osxtime_t cavail = chfree ? xnow : getAvail(LMIC.dyn.bandChAvail[b]);
+            debug_verbose_printf("Considering channels 0x%04x in band %u, available at %t (channels at %t)\r\n", bcmap, b, (ostime_t)bavail, (ostime_t)cavail);
+            osxtime_t avail;
+            if( REGION.flags & REG_PSA ) {
+                // PSA: channel can be used if band DC (unconditional)
+                // or channel DC (PSA) are available
+                if( bavail <= xnow ) {
+                    ccmap |= bcmap;  // just use the channels without probe
+                    avail = bavail;
+                } else {
+                    ccmap |= chfree; // if PSA DC permits then probe these channels
+                    pcmap |= chfree;
+                    avail = cavail;
+                }
+            } else {
+                // do not use channel unless both band+channel DC are available
+                avail = (bavail > cavail) ? bavail : cavail;
+                if( avail <= xnow ) {
+                    ccmap |= chfree;
+                }
+            }
+            if( txavail > avail ) {
+                txavail = avail;
+            }
+        }
+    }
 
-    if (cccnt) {
+    if( ccmap ) {
+        u1_t cccnt = __builtin_popcount(ccmap); // number of candidate channels
         debug_verbose_printf("%u channels are available now\r\n", cccnt);
         while( cccnt ) {
             u1_t chnl = selectRandomChnl(ccmap, cccnt);
 
-            if (REGION.ccaThreshold
-                    && (((REGION.flags & REG_PSA) == 0) || pcmap & (1 << chnl))) {
+            bit_t cca = REGION.ccaThreshold
+                && (((REGION.flags & REG_PSA) == 0) || pcmap & (1 << chnl));
+            if (cca || (LMIC.cadMode & CAD_LBT)) {
                 // perform CCA
                 LMIC.rps = updr2rps(LMIC.datarate);
                 LMIC.freq = LMIC.dyn.chUpFreq[chnl] & ~BAND_MASK;
-                LMIC.rxtime = REGION.ccaTime;
-                LMIC.rssi = REGION.ccaThreshold;
-                os_radio(RADIO_CCA);
-                if (LMIC.rssi >= REGION.ccaThreshold) { // channel is not available
+                if (lbtBusy(cca)) { // channel is not available
                     debug_verbose_printf("Channel %u not available due to CCA\r\n", chnl);
                     goto unavailable;
                 }
@@ -1144,7 +1265,8 @@ static ostime_t nextJoinState (void) {
 
     if( REG_IS_FIX() ) {
 #ifdef REG_FIX
-        // NOTE: this is incorrect for CN470, but CN470 is a moving target anyway...
+        // Walk the 125kHz channels in hoplist order, after each block of numChBlocks
+        // try a fix-DR channel (US915/AU915 - CN470 has none)
         if( LMIC.datarate == REGION.fixDr ) {
             // switch back to var-DR channels
             goto nextblock;
@@ -1256,29 +1378,71 @@ static int numChannels (void) {
     return (REGION.baseFreqFix ? 9 : 8) * REGION.numChBlocks;
 }
 
-// return: 1 - some channels were disabled, 0 - all channels were already enabled
-static u1_t enableAllChannels_fix (void) {
+// return up to 16 bits of a channel map starting at channel index off
+static u2_t mapBits_fix (const u2_t* map, int off, int n) {
+    int w = off >> 4;
+    u4_t bits = map[w];
+    if( w + 1 < CHMAP_SZ ) {
+        bits |= (u4_t) map[w + 1] << 16;
+    }
+    return (bits >> (off & 15)) & ((1 << n) - 1);
+}
+
+// hoplist needs to be rebuilt before next hop
+#define HOPCNT_STALE 0xFF
+
+// rebuild hoplist to list enabled 125kHz channels only (in hop order)
+static void updateHopList_fix (void) {
+    int nch = REGION.numChBlocks * 8;
+    u1_t* hl = LMIC.fix.hoplist;
+    int n = 0, ref = -1;
+    generateHopList(hl, nch);
+    for( int i = 0; i < nch; i++ ) {
+        u1_t chnl = hl[i];
+        if( LMIC.fix.channelMap[chnl >> 4] & (1 << (chnl & 0xF)) ) {
+            hl[n++] = chnl;
+        }
+        if( chnl == LMIC.txChnl ) {
+            ref = n - 1; // continue hopping after last used channel
+        }
+    }
+    LMIC.fix.hopcnt = n;
+    LMIC.refChnl = (ref < 0) ? n - 1 : ref;
+}
+
+// set all channels in map - return: 1 - some channels were disabled, 0 - all channels were already enabled
+static u1_t setAllChannels_fix (u2_t* map) {
     int nch = numChannels();
     u1_t rv = 0;
     for (u1_t i = 0; i < (nch >> 4); i++) {
-        if (LMIC.fix.channelMap[i] != 0xffff) {
-            LMIC.fix.channelMap[i] = 0xffff;
+        if (map[i] != 0xffff) {
+            map[i] = 0xffff;
             rv = 1;
         }
     }
     if (nch & 0xf) {
-        u1_t newval = (1 << (nch & 0xf)) - 1;
-        if (LMIC.fix.channelMap[nch >> 4] != newval) {
-            LMIC.fix.channelMap[nch >> 4]  = newval;
+        u2_t newval = (1 << (nch & 0xf)) - 1;
+        if (map[nch >> 4] != newval) {
+            map[nch >> 4]  = newval;
             rv = 1;
         }
     }
     return rv;
 }
 
+// return: 1 - some channels were disabled, 0 - all channels were already enabled
+static u1_t enableAllChannels_fix (void) {
+    if( setAllChannels_fix(LMIC.fix.channelMap) ) {
+        LMIC.fix.hopcnt = HOPCNT_STALE;
+        return 1;
+    }
+    return 0;
+}
+
 static void disableChannel_fix (u1_t chidx) {
     if (chidx < numChannels()) {
         LMIC.fix.channelMap[chidx >> 4] &= ~(1 << (chidx & 0xF));
+        LMIC.fix.hopcnt = HOPCNT_STALE;
     }
     // safety net - all channels disabled -> turn all on -- XXX maybe we shouldn't?
     for (u1_t i = 0; i < sizeof(LMIC.fix.channelMap) / sizeof(u2_t); i++) {
@@ -1293,7 +1457,7 @@ static void initDefaultChannels_fix (void) {
     generateHopList(LMIC.fix.hoplist, REGION.numChBlocks * 8);
 
 #if 0
-    for( int i = 0; i < 64; i++ ) {
+    for( int i = 0; i < REGION.numChBlocks * 8; i++ ) {
         debug_printf("%2d ", LMIC.fix.hoplist[i]);
         if( (i & 7) == 7 ) {
             debug_printf("\r\n");
@@ -1302,7 +1466,8 @@ static void initDefaultChannels_fix (void) {
 #endif
 
     os_clearMem(LMIC.fix.channelMap, sizeof(LMIC.fix.channelMap));
-    enableAllChannels_fix();
+    setAllChannels_fix(LMIC.fix.channelMap);
+    LMIC.fix.hopcnt = REGION.numChBlocks * 8;
 }
 
 static void prepareDn_fix () {
@@ -1312,13 +1477,10 @@ static void prepareDn_fix () {
 }
 
 static int activeFhssChannelCount_fix (u2_t* channelMap) {
-    int i, cc = 0;
-    for( i = 0; i < REGION.numChBlocks; i+=2 ) {
-        u2_t map = channelMap[i/2];
-        if( i+1 == REGION.numChBlocks ) {
-            map &= 0x00ff; // numChBlocks is odd - avoid reading special channels (e.g. 500kHz)
-        }
-        cc += __builtin_popcount(map);
+    int i, cc = 0, nch = REGION.numChBlocks * 8;
+    for( i = 0; i < nch; i += 16 ) {
+        // numChBlocks might be odd - avoid reading special channels (e.g. 500kHz)
+        cc += __builtin_popcount(mapBits_fix(channelMap, i, (nch - i < 16) ? nch - i : 16));
     }
     return cc;
 }
@@ -1340,43 +1502,54 @@ static u1_t checkChannelMap_fix (u2_t* map) {
 }
 
 static u1_t applyChannelMap_fix (u1_t chpage, u2_t chmap, u2_t* dest) {
-    if (chpage == MCMD_LADR_CHP_125ON || chpage == MCMD_LADR_CHP_125OFF) {
+    if( REGION.baseFreqFix == 0 ) {
+        // CN470: no special channel pages - pages 0..5 cover all channels, 6 enables all, 7 is RFU
+        if( chpage == MCMD_LADR_CHP_ALLON ) {
+            setAllChannels_fix(dest);
+            return 1;
+        }
+    } else if (chpage == MCMD_LADR_CHP_125ON || chpage == MCMD_LADR_CHP_125OFF) {
         u2_t en125 = (chpage == MCMD_LADR_CHP_125ON) ? 0xFFFF : 0x0000;
         for (u1_t u = 0; u < (REGION.numChBlocks >> 1); u++) {
             dest[u] = en125;
         }
         dest[REGION.numChBlocks >> 1] = chmap;
+        return 1;
     } else if( chpage == MCMD_LADR_CHP_BLK8 )  {
         dest[REGION.numChBlocks >> 1] = chmap & 0xFF;
         for (u1_t u = 0; u < (REGION.numChBlocks >> 1); u++) {
             dest[u] = ((chmap & 1) ? 0x00ff : 0) | ((chmap & 2) ? 0xff00 : 0);
             chmap >>= 2;
         }
-    } else {
-        int nch = numChannels();
-        chpage >>= MCMD_LADR_CHPAGE_SHIFT;
-        if (chpage >= ((nch+15) >> 4)) {
-            return 0;
-        }
-        if ((nch & 15) && chpage == (REGION.numChBlocks >> 1)) { // partial map in last 16bit word
-            chmap &= ~(0xffff << (nch & 15));
-        }
-        dest[chpage] = chmap;
+        return 1;
     }
+    int nch = numChannels();
+    chpage >>= MCMD_LADR_CHPAGE_SHIFT;
+    if (chpage >= ((nch+15) >> 4)) {
+        return 0;
+    }
+    if ((nch & 15) && chpage == (nch >> 4)) { // partial map in last 16bit word
+        chmap &= ~(0xffff << (nch & 15));
+    }
+    dest[chpage] = chmap;
     return 1;
 }
 
-static void updateTx_fix (ostime_t txbeg) {  //XXX:BUG: this is US915/AU915 centric - won't work for CN470
+static u4_t chnlFreq_fix (u1_t chnl) {
+    if( chnl < REGION.numChBlocks*8 ) {
+        return REGION.baseFreq125 + chnl*UPCHSPACING_125kHz;
+    }
+    // fix-DR channels - only regions with baseFreqFix (US915/AU915)
+    ASSERT(REGION.baseFreqFix);
+    return REGION.baseFreqFix + (chnl-REGION.numChBlocks*8)*UPCHSPACING_500kHz;
+}
+
+static void updateTx_fix (ostime_t txbeg) {
     ostime_t airtime = calcAirTime(LMIC.rps, LMIC.dataLen);
     u1_t chnl = LMIC.txChnl;
     LMIC.txpow = LMIC.txPowAdj + REGION.maxEirp;
+    LMIC.freq = chnlFreq_fix(chnl);
     if( chnl < REGION.numChBlocks*8 ) {
-        LMIC.freq = REGION.baseFreq125 + chnl*UPCHSPACING_125kHz;
-#if CFG_cn470
-        if( isREGION(CN470) )
-            goto updateGDC;
-#endif
-
 #if CFG_us915
         if( isREGION(US915) ) {
             // US915 FHSS: max 1 transmission every 400 ms
@@ -1389,7 +1562,6 @@ static void updateTx_fix (ostime_t txbeg) {  //XXX:BUG: this is US915/AU915 cent
         }
 #endif
     } else {
-        LMIC.freq = REGION.baseFreqFix + (chnl-REGION.numChBlocks*8)*UPCHSPACING_500kHz;
 #if CFG_us915
         if( isREGION(US915) ) {
             // US915 DTS mode: limit TX power to 26dBm
@@ -1400,9 +1572,6 @@ static void updateTx_fix (ostime_t txbeg) {  //XXX:BUG: this is US915/AU915 cent
 #endif
     }
 
-#if CFG_cn470
-  updateGDC:
-#endif
     // Update global duty cycle stats
     if( LMIC.globalDutyRate != 0 ) {
         LMIC.globalDutyAvail = txbeg + (airtime<<LMIC.globalDutyRate);
@@ -1415,20 +1584,11 @@ static void updateTx_fix (ostime_t txbeg) {  //XXX:BUG: this is US915/AU915 cent
 
 // check if a channel is available in the map that supports this datarate
 static bool checkChannel_fix (u2_t* map, dr_t dr) {
-    u1_t beg8, end8;
     if( dr == REGION.fixDr ) {
-        beg8 = REGION.numChBlocks;
-        end8 = CHMAP_SZ*2;
-    } else {
-        beg8 = 0;
-        end8 = REGION.numChBlocks;
-    }
-    for( ;beg8 < end8; beg8++ ) {
-        if( (map[beg8>>1] >> ((beg8 & 1)<<3)) & 0xff ) {
-            return true;
-        }
+        // one fix-DR channel per 8ch block following the 125kHz channels
+        return mapBits_fix(map, REGION.numChBlocks*8, REGION.numChBlocks) != 0;
     }
-    return false;
+    return activeFhssChannelCount_fix(map) != 0;
 }
 
 static void syncDatarate_fix () {
@@ -1454,31 +1614,54 @@ static void setBcnRxParams_fix (void) {
 }
 #endif
 
+// advance to next enabled channel for current datarate
+static void nextChnl_fix (void) {
+    u1_t off = REGION.numChBlocks*8;
+    if( LMIC.datarate == REGION.fixDr ) {
+        // assuming for every 8ch 125 is one fix DR ch (iff fixDr != ILLEGAL_DR)
+        u2_t map = mapBits_fix(LMIC.fix.channelMap, off, REGION.numChBlocks);
+        if( map ) {
+            u2_t next = map & ~((2 << (LMIC.refChnl % REGION.numChBlocks)) - 1);
+            LMIC.refChnl = __builtin_ctz(next ? next : map);
+            LMIC.txChnl = LMIC.refChnl + off;
+        }
+    } else {
+        // 125kHz
+        if( LMIC.fix.hopcnt == HOPCNT_STALE ) {
+            updateHopList_fix();
+        }
+        if( LMIC.fix.hopcnt ) {
+            if( ++LMIC.refChnl >= LMIC.fix.hopcnt ) {
+                LMIC.refChnl = 0;
+            }
+            LMIC.txChnl = LMIC.fix.hoplist[LMIC.refChnl];
+        }
+    }
+}
+
 static ostime_t nextTx_fix (ostime_t now) {
+    osxtime_t xnow = os_time2XTime(now, os_getXTime());
+    osxtime_t avail = getAvail(LMIC.globalAvail);
     if( LMIC.opmode & OP_NEXTCHNL ) {
-        if( LMIC.datarate == REGION.fixDr ) {
-            u1_t off = REGION.numChBlocks*8;
-            for( u1_t i=0, e=REGION.numChBlocks; i<e; i++ ) {  // assuming for every 8ch 125 is one fix DR ch (iff fixDr != ILLEGAL_DR)
-                u1_t chnl = ++LMIC.refChnl % e + off;
-                if( (LMIC.fix.channelMap[(chnl >> 4)] & (1<<(chnl & 0xF))) != 0 ) {
-                    LMIC.txChnl = chnl;
+        nextChnl_fix();
+        if( (LMIC.cadMode & CAD_LBT) && xnow >= avail ) {
+            // CAD based LBT - try a few more channels if busy
+            for( u1_t i = 0; ; i++ ) {
+                LMIC.rps = updr2rps(LMIC.datarate);
+                LMIC.freq = chnlFreq_fix(LMIC.txChnl);
+                if( !lbtBusy(0) ) {
                     break;
                 }
-            }
-        } else {
-            // 125kHz
-            for( u1_t i=0, e=REGION.numChBlocks*8; i<e; i++ ) {
-                u1_t chnl = LMIC.fix.hoplist[++LMIC.refChnl % e];
-                if( (LMIC.fix.channelMap[(chnl >> 4)] & (1<<(chnl & 0xF))) != 0 ) {
-                    LMIC.txChnl = chnl;
-                    break;
+                debug_verbose_printf("Channel %u not available due to CCA\r\n", LMIC.txChnl);
+                if( i == 2 ) {
+                    // Avoid being bombarded...
+                    return os_getTime() + ms2osticks(100);
                 }
+                nextChnl_fix();
             }
         }
     }
     LMIC.opmode &= ~OP_NEXTCHNL;  // channel decision is stable
-    osxtime_t xnow = os_time2XTime(now, os_getXTime());
-    osxtime_t avail = getAvail(LMIC.globalAvail);
     return (ostime_t) ((xnow >= avail) ? xnow : avail);
 }
 
@@ -1590,6 +1773,7 @@ static bit_t decodeFrame (void) {
     u1_t ftype  = hdr & HDR_FTYPE;
     int  dlen   = LMIC.dataLen;
     const char *window = (LMIC.txrxFlags & TXRX_DNW1) ? "RX1" : ((LMIC.txrxFlags & TXRX_DNW2) ? "RX2" : "Other");
+    LMIC.dnMcgrp = -1;
     if( dlen < OFF_DAT_OPTS+4 ||
         dlen > maxDnLen(LMIC.rps) ||
         (hdr & HDR_MAJOR) != HDR_MAJOR_V1 ||
@@ -1763,6 +1947,7 @@ static bit_t decodeFrame (void) {
                 if (REG_IS_FIX()) {
 #ifdef REG_FIX
                     os_copyMem(LMIC.fix.channelMap, dmap, sizeof(LMIC.fix.channelMap));
+                    LMIC.fix.hopcnt = HOPCNT_STALE;
 #endif
                 } else {
 #ifdef REG_DYN
@@ -2036,6 +2221,7 @@ static bit_t decodeMultiCastFrame (void) {
     u1_t hdr    = d[0];
     u1_t ftype  = hdr & HDR_FTYPE;
     int  dlen   = LMIC.dataLen;
+    LMIC.dnMcgrp = -1;
     if( dlen < OFF_DAT_OPTS+4 ||
         (hdr & HDR_MAJOR) != HDR_MAJOR_V1 ||
         ftype != HDR_FTYPE_DADN ) {
@@ -2096,6 +2282,7 @@ static bit_t decodeMultiCastFrame (void) {
     if( pend-poff > 0 ) {
         lce_cipher(LCE_MCGRP_0 + (s-LMIC.sessions), s->grpaddr, seqno, /*dn*/1, d+poff, pend-poff);
     }
+    LMIC.dnMcgrp = s - LMIC.sessions;
 
     if( port < 0 ) {
         LMIC.txrxFlags |= TXRX_NOPORT;
@@ -2114,12 +2301,17 @@ static bit_t decodeMultiCastFrame (void) {
 // TX/RX transaction support
 
 
+// start single RX window at LMIC.rxtime - use CAD first if enabled (LoRa only)
+static void startRx (void) {
+    os_radio(((LMIC.cadMode & CAD_RXWIN) && isLora(LMIC.rps)) ? RADIO_RXCAD : RADIO_RX);
+}
+
 static void setupRx2 (void) {
     LMIC.txrxFlags = (LMIC.txrxFlags & TXRX_NOTX) | TXRX_DNW2;
     LMIC.rps = dndr2rps(LMIC.dn2Dr);
     LMIC.freq = LMIC.dn2Freq;
     LMIC.dataLen = 0;
-    os_radio(RADIO_RX);
+    startRx();
 }
 
 
@@ -2145,7 +2337,7 @@ static void setupRx1 (osjobcb_t func) {
     LMIC.rps = setNocrc(LMIC.rps,1);
     LMIC.dataLen = 0;
     LMIC.osjob.func = func;
-    os_radio(RADIO_RX);
+    startRx();
 }
 
 
@@ -2153,7 +2345,7 @@ static void setupRx1 (osjobcb_t func) {
 static void txDone (u1_t delay, osjobcb_t func) {
 #if !defined(DISABLE_CLASSB)
     if( (LMIC.opmode & (OP_TRACK|OP_PINGABLE|OP_PINGINI)) == (OP_TRACK|OP_PINGABLE) ) {
-        rxschedInit(&LMIC.ping);    // note: reuses LMIC.frame buffer!
+        rxschedInit(&LMIC.ping, LMIC.devaddr);    // note: reuses LMIC.frame buffer!
         LMIC.opmode |= OP_PINGINI;
     }
 #endif
@@ -2243,9 +2435,10 @@ static bit_t processJoinAccept (void) {
                 goto badframe;
             }
             LMIC.frame[OFF_CFLIST + 15] = 0; // so we can read the last byte with os_rlsbf2()
-            for (u1_t i=0; i < 8 && i < CHMAP_SZ; i++, dlen += 2) {
+            for (u1_t i=0; i < 8 && i < ((numChannels()+15) >> 4); i++, dlen += 2) {
                 LMIC.fix.channelMap[i] = os_rlsbf2(&LMIC.frame[dlen]);
             }
+            LMIC.fix.hopcnt = HOPCNT_STALE;
         } else
 #endif // REG_FIX
         {
@@ -2314,6 +2507,7 @@ static void jreqDone (osjob_t* osjob) {
 
 // Fwd decl.
 static bit_t processDnData(void);
+static void setupRxClassC (ostime_t now, bit_t sniff);
 
 static void processRx2DnDataDelay (osjob_t* osjob) {
     (void)osjob; // unused
@@ -2373,7 +2567,7 @@ static void setupRx2ClassC () {
 static void processRx1ClassC (osjob_t* osjob) {
     (void)osjob; // unused
     if( !processDnData() ) {
-        setupRx2ClassC();
+        setupRxClassC(os_getTime(), 1);
     }
 }
 
@@ -2387,12 +2581,107 @@ static void setupRx1ClassC (osjob_t* osjob) {
     setupRx1(FUNC_ADDR(processRx1ClassC));
 }
 
+// Window edge of class C multicast session - restart (or stop) continuous RX.
+// If a transaction, scan or beacon tracking owns the radio, leave it alone:
+// the edge is picked up by the engineUpdate following its completion.
+static void mcClassCEdge (osjob_t* osjob) {
+    (void)osjob; // unused
+    if( (LMIC.opmode & (OP_NOENGINE|OP_TXRXPEND|OP_SHUTDOWN|OP_SCAN|OP_TRACK)) != 0 ) {
+        return;
+    }
+    os_radio(RADIO_STOP);
+    os_clearCallback(&LMIC.osjob);
+    engineUpdate();
+}
+
+// Return multicast group with open class C window (first one wins if windows
+// overlap), close expired windows and arm job for the next window edge
+static session_t* mcClassC (ostime_t now) {
+    session_t* open = NULL;
+    ostime_t next = 0;
+    bit_t arm = 0;
+    for( session_t* s = LMIC.sessions; s < LMIC.sessions+MAX_MULTICAST_SESSIONS; s++ ) {
+        if( s->mode != MC_CLASS_C )
+            continue;
+        if( now - s->ccEnd >= 0 ) {
+            s->mode = MC_CLASS_A;   // window over
+            continue;
+        }
+        ostime_t t = s->ccBeg;
+        if( now - t >= 0 ) {
+            if( open == NULL )
+                open = s;
+            t = s->ccEnd;
+        }
+        if( !arm || t - next < 0 ) {
+            next = t;
+            arm = 1;
+        }
+    }
+    if( arm ) {
+        os_setTimedCallback(&LMIC.mccjob, next, FUNC_ADDR(mcClassCEdge));
+    } else {
+        os_clearCallback(&LMIC.mccjob);
+    }
+    return open;
+}
+
+// CAD-gated RX done - if nothing was detected just schedule the next CAD
+static void processRxMcClassC (osjob_t* osjob) {
+    if( LMIC.dataLen == 0 ) {
+        setupRxClassC(os_getTime(), 1);
+    } else {
+        processRx2ClassC(osjob);
+    }
+}
+
+static void startRxMcClassC (osjob_t* osjob) {
+    (void)osjob; // unused
+    LMIC.osjob.func = FUNC_ADDR(processRxMcClassC);
+    os_radio(RADIO_RXCAD);
+}
+
+// Start continuous RX if class C or a class C multicast window is open. With
+// CAD_RXWIN (and sniff) RX within windows is CAD-gated: the radio only wakes
+// up for a CAD every half preamble and stays on only if a preamble is detected.
+// Windows are not served while tracking beacons (class B groups use ping slots).
+static void setupRxClassC (ostime_t now, bit_t sniff) {
+    session_t* s = NULL;
+    if( (LMIC.opmode & OP_TRACK) == 0 ) {
+        s = mcClassC(now);
+    } else {
+        os_clearCallback(&LMIC.mccjob);
+    }
+    if( s == NULL ) {
+        if( (LMIC.clmode & CLASS_C) ) {
+            setupRx2ClassC();
+        }
+        return;
+    }
+    LMIC.osjob.func = FUNC_ADDR(processRx2ClassC);
+    LMIC.txrxFlags = TXRX_DNW2;
+    LMIC.rps = dndr2rps(s->ccDr);
+    LMIC.freq = s->ccFreq;
+    LMIC.dataLen = 0;
+    if( sniff && (LMIC.cadMode & CAD_RXWIN) && isLora(LMIC.rps) ) {
+        ostime_t rxtime = LMIC.rxtime + dr2hsym(s->ccDr, PAMBL_SYMS);
+        if( rxtime - (now + RX_RAMPUP) < 0 )
+            rxtime = now + RX_RAMPUP;
+        LMIC.rxtime = rxtime;
+        LMIC.rxsyms = PAMBL_SYMS;
+        os_setTimedCallback(&LMIC.osjob, rxtime - RX_RAMPUP, FUNC_ADDR(startRxMcClassC));
+    } else {
+        os_radio(RADIO_RXON);
+    }
+}
+
 static void txError (void) {
     LMIC.opmode &= ~(OP_TXDATA|OP_TXRXPEND);
     LMIC.txrxFlags = TXRX_NOTX;
     LMIC.dataBeg = 0;
     LMIC.dataLen = 0;
     LMIC.pendTxNoRx = 0;
+    LMIC.pendTxBuf = NULL;
     reportEvent(EV_TXCOMPLETE);
 }
 
@@ -2521,6 +2810,8 @@ static void buildDataFrame (void) {
         debug_printf("MAC commands large (%u > %u), sending only MAC commands\n", foptslen, foptslen_max);
         // too big for FOpts, send as MAC frame with port=0 (cancels application payload)
         memcpy(LMIC.pendTxData, LMIC.frame+OFF_DAT_OPTS, foptslen);
+        LMIC.pendTxBuf = NULL;
+        LMIC.pendTxJit = NULL;
         dlen = foptslen;
         LMIC.pendTxPort = 0;
         LMIC.pendTxConf = 0;
@@ -2535,6 +2826,21 @@ static void buildDataFrame (void) {
     int flen, flen_max = MAX_LEN_FRAME;
     if (LMIC.datarate != CUSTOM_DR)
         flen_max = LMIC_maxAppPayload() + 13;
+
+    if( txdata && LMIC.pendTxJit && LMIC.txCnt == 0 ) {
+        // let app refresh payload now that channel and DR are final (not on retransmissions)
+        int room = flen_max - end - 5;
+        if( room < 0 )
+            room = 0;
+        if( LMIC.pendTxBuf ) {
+            os_copyMem(LMIC.pendTxData, LMIC.pendTxBuf, dlen);
+            LMIC.pendTxBuf = NULL;
+        }
+        int n = LMIC.pendTxJit(LMIC.pendTxData, room);
+        ASSERT((unsigned int) n <= (unsigned int) room);
+        LMIC.pendTxJit = NULL;
+        LMIC.pendTxLen = dlen = n;
+    }
 again:
     flen = end + (txdata ? 5+dlen : 4);
     if( flen > flen_max ) {
@@ -2583,7 +2889,8 @@ again:
             LMIC.frame[OFF_DAT_HDR] = HDR_FTYPE_DCUP | HDR_MAJOR_V1;
         }
         LMIC.frame[end] = LMIC.pendTxPort;
-        os_copyMem(LMIC.frame+end+1, LMIC.pendTxData, dlen);
+        // single copy into frame (shared with RX windows), encrypted in place
+        os_copyMem(LMIC.frame+end+1, LMIC.pendTxBuf ? LMIC.pendTxBuf : LMIC.pendTxData, dlen);
         lce_cipher(LMIC.pendTxPort==0 ? LCE_NWKSKEY : LCE_APPSKEY,
                    LMIC.devaddr, LMIC.seqnoUp-1, /*up*/0, LMIC.frame+end+1, dlen);
     }
@@ -2803,7 +3110,7 @@ static void processPingRx (osjob_t* osjob) {
     (void)osjob; // unused
     if( LMIC.dataLen != 0 ) {
         LMIC.txrxFlags = TXRX_PING;
-        if( decodeFrame() ) {
+        if( (LMIC.devaddr == os_rlsbf4(&LMIC.frame[OFF_DAT_ADDR])) ? decodeFrame() : decodeMultiCastFrame() ) {
             reportEvent(EV_RXCOMPLETE);
             return;
         }
@@ -2846,6 +3153,7 @@ static bit_t processDnData (void) {
         }
         LMIC.nbTrans &= ~IGN_NBTRANS;   // auto clear ignore
         LMIC.opmode &= ~OP_TXRXPEND;
+        LMIC.pendTxBuf = NULL;  // caller buffer released
         reportEvent(EV_TXCOMPLETE);
         // If we haven't heard from NWK in a while although we asked for a sign
         // assume link is dead - notify application and keep going
@@ -2961,7 +3269,8 @@ static void processBeacon (osjob_t* osjob) {
   rev:
     LMIC.bcnChnl = (LMIC.bcnChnl+1) % numBcnChannels();
     if( (LMIC.opmode & OP_PINGINI) != 0 )
-        rxschedInit(&LMIC.ping);  // note: reuses LMIC.frame buffer!
+        rxschedInit(&LMIC.ping, LMIC.devaddr);  // note: reuses LMIC.frame buffer!
+    rxschedInitMcast();
     reportEvent(ev);
 }
 
@@ -2975,7 +3284,7 @@ static void startRxBcn (osjob_t* osjob) {
 static void startRxPing (osjob_t* osjob) {
     (void)osjob; // unused
     LMIC.osjob.func = FUNC_ADDR(processPingRx);
-    os_radio(RADIO_RX);
+    startRx();
 }
 #endif
 
@@ -3001,6 +3310,8 @@ static void engineUpdate (void) {
 
 #if !defined(DISABLE_CLASSB)
     ostime_t rxtime = 0;
+    // RX_RAMPUP may change with radio state - use one value for this decision
+    ostime_t rxrampup = RX_RAMPUP;
 
     if( (LMIC.opmode & OP_SCAN) != 0 ) {
         // Looking for a beacon - LMIC.bcninfo.txtime is timeout for scan
@@ -3016,17 +3327,21 @@ static void engineUpdate (void) {
     }
     if( (LMIC.opmode & OP_TRACK) != 0 ) {
         // We are tracking a beacon
-        rxtime = LMIC.bcnRxtime - RX_RAMPUP;
+        rxtime = LMIC.bcnRxtime - rxrampup;
 #if CFG_simul
         // Simulation is sometimes late - don't die here but keep going.
         // Results in a missed beacon. On the HW this spells a more serious problem.
-        if( (ostime_t)(rxtime-now) < 0 ) {
+        if( (ostime_t)(LMIC.bcnRxtime-now) < 0 ) {
             fprintf(stderr, "ERROR: engineUpdate/OP_TRACK: delta=%d now=0x%X rxtime=0x%X LMIC.bcnRxtime=0x%X RX_RAMPUP=%d\n",
-                    (ostime_t)(rxtime-now),now,rxtime,LMIC.bcnRxtime,RX_RAMPUP);
+                    (ostime_t)(rxtime-now),now,rxtime,LMIC.bcnRxtime,rxrampup);
         }
 #else
-        ASSERT( (ostime_t)(rxtime-now) >= 0 );
+        ASSERT( (ostime_t)(LMIC.bcnRxtime-now) >= 0 );
 #endif
+        // ramp-up may have grown since the beacon window was planned (radio
+        // config lost) - then start right away, the RX window margin covers it
+        if( (ostime_t)(rxtime-now) < 0 )
+            rxtime = now;
     }
 #endif
     if( LMIC.pollcnt )
@@ -3137,28 +3452,27 @@ static void engineUpdate (void) {
     } else {
         // No TX pending - no scheduled RX
         if( (LMIC.opmode & OP_TRACK) == 0 ) {
-            if( (LMIC.clmode & CLASS_C) ) {
-                setupRx2ClassC();
-            }
+            setupRxClassC(now, 1);
             return;
         }
     }
 
 #if !defined(DISABLE_CLASSB)
-    // Are we pingable?
+    // Are we pingable (unicast or multicast)?
   checkrx:
-    if( (LMIC.opmode & OP_PINGINI) != 0 ) {
+    {
         // One more RX slot in this beacon period?
-        if( rxschedNext(&LMIC.ping, now+RX_RAMPUP) ) {
-            if( txbeg != 0  &&  (txbeg - LMIC.ping.rxtime) < 0 )
+        rxsched_t* rxsched = rxschedPick(now+rxrampup);
+        if( rxsched != NULL ) {
+            if( txbeg != 0  &&  (txbeg - rxsched->rxtime) < 0 )
                 goto txdelay;
-            LMIC.rxsyms  = LMIC.ping.rxsyms;
-            LMIC.rxtime  = LMIC.ping.rxtime;
-            LMIC.freq    = LMIC.ping.freq;          // XXX:US like => calc based on beacon time!
-            LMIC.rps     = dndr2rps(LMIC.ping.dr);
+            LMIC.rxsyms  = rxsched->rxsyms;
+            LMIC.rxtime  = rxsched->rxtime;
+            LMIC.freq    = rxsched->freq;           // XXX:US like => calc based on beacon time!
+            LMIC.rps     = dndr2rps(rxsched->dr);
             LMIC.dataLen = 0;
-            ASSERT(LMIC.rxtime - now+RX_RAMPUP >= 0 );
-            os_setTimedCallback(&LMIC.osjob, LMIC.rxtime - RX_RAMPUP, FUNC_ADDR(startRxPing));
+            ASSERT(LMIC.rxtime - (now+rxrampup) >= 0 );
+            os_setTimedCallback(&LMIC.osjob, LMIC.rxtime - rxrampup, FUNC_ADDR(startRxPing));
             return;
         }
         // no - just wait for the beacon
@@ -3180,9 +3494,7 @@ static void engineUpdate (void) {
 #endif
 
   txdelay:
-    if( (LMIC.clmode & CLASS_C) ) {
-        setupRx2ClassC();
-    }
+    setupRxClassC(now, 0);
     os_setTimedCallback(&LMIC.osjob, txbeg-TX_RAMPUP, FUNC_ADDR(runEngineUpdate));
 }
 
@@ -3219,6 +3531,7 @@ void LMIC_selectChannel(u1_t channel) {
 
 void LMIC_shutdown (void) {
     os_clearCallback(&LMIC.osjob);
+    os_clearCallback(&LMIC.mccjob);
     os_radio(RADIO_STOP);
     LMIC.opmode |= OP_SHUTDOWN;
 }
@@ -3244,6 +3557,7 @@ u1_t LMIC_regionCode (u1_t regionIdx) {
 void LMIC_reset_ex (u1_t regionCode) {
     os_radio(RADIO_STOP);
     os_clearCallback(&LMIC.osjob);
+    os_clearCallback(&LMIC.mccjob);
 
     os_clearMem((u1_t*) &LMIC, sizeof(LMIC));
 
@@ -3272,6 +3586,7 @@ void LMIC_reset_ex (u1_t regionCode) {
     LMIC.adrAckLimit  = ADR_ACK_LIMIT;
     LMIC.adrAckDelay  = ADR_ACK_DELAY;
     LMIC.adrAckReq    = LINK_CHECK_INIT;
+    LMIC.dnMcgrp      = -1;
 
     iniRxdErr();
 }
@@ -3287,6 +3602,8 @@ void LMIC_init (void) {
 void LMIC_clrTxData (void) {
     LMIC.opmode &= ~(OP_TXDATA|OP_TXRXPEND|OP_POLL);
     LMIC.pendTxLen = 0;
+    LMIC.pendTxBuf = NULL;
+    LMIC.pendTxJit = NULL;
     if( (LMIC.opmode & (OP_JOINING|OP_SCAN)) != 0 ) // do not interfere with JOINING/SCANNING
         return;
     os_clearCallback(&LMIC.osjob);
@@ -3296,7 +3613,14 @@ void LMIC_clrTxData (void) {
 
 
 void LMIC_setTxData (void) {
+    LMIC_setTxDataBuf(NULL);
+}
+
+// Like LMIC_setTxData() but the payload (pendTxLen bytes) is sent straight from
+// the caller's buffer, which must stay unchanged until EV_TXCOMPLETE
+void LMIC_setTxDataBuf (const u1_t* buf) {
     ASSERT((LMIC.opmode & OP_JOINING) == 0);
+    LMIC.pendTxBuf = buf;
     LMIC.opmode |= OP_TXDATA;
     LMIC.txCnt = 0;             // reset nbTrans counter
     engineUpdate();
@@ -3309,6 +3633,8 @@ int LMIC_setTxData2 (u1_t port, u1_t* data, u1_t dlen, u1_t confirmed) {
         return -2;
     if( data != (u1_t*)0 )
         os_copyMem(LMIC.pendTxData, data, dlen);
+    LMIC.pendTxBuf  = NULL;
+    LMIC.pendTxJit  = NULL;
     LMIC.pendTxConf = confirmed;
     LMIC.pendTxPort = port;
     LMIC.pendTxLen  = dlen;
@@ -3405,21 +3731,71 @@ int LMIC_setMultiCastSession (devaddr_t grpaddr, const u1_t* nwkKeyDn, const u1_
     if (s >= LMIC.sessions+MAX_MULTICAST_SESSIONS)
         return 0;
 
+    if( s->grpaddr != grpaddr )
+        s->mode = MC_CLASS_A;   // new group - no class B slots or class C window yet
     s->grpaddr  = grpaddr;
     s->seqnoADn = seqnoADn;
 
     if( nwkKeyDn != (u1_t*)0 ) {
-        os_copyMem(s->nwkKeyDn, nwkKeyDn, 16);
         os_copyMem(&LMIC.lceCtx.mcgroup[LCE_MCGRP_0 + (s-LMIC.sessions)].nwkSKeyDn, nwkKeyDn, 16);
     }
 
     if( appKey != (u1_t*)0 ) {
-        os_copyMem(s->appKey, appKey, 16);
         os_copyMem(&LMIC.lceCtx.mcgroup[LCE_MCGRP_0 + (s-LMIC.sessions)].appSKey, appKey, 16);
     }
     return 1;
 }
 
+#if !defined(DISABLE_CLASSB)
+// Configure class B ping slots of multicast group (intvExp > 7 disables).
+// Slots are scheduled from the next beacon on, replacing any class C window.
+int LMIC_setMultiCastPing (devaddr_t grpaddr, u1_t intvExp, freq_t freq, dr_t dr) {
+    session_t* s;
+    for(s = LMIC.sessions; s<LMIC.sessions+MAX_MULTICAST_SESSIONS && s->grpaddr!=grpaddr; s++);
+    if( grpaddr == 0 || s >= LMIC.sessions+MAX_MULTICAST_SESSIONS )
+        return 0;
+    if( intvExp > 7 ) {
+        if( s->mode == MC_CLASS_B )
+            s->mode = MC_CLASS_A;
+        return 1;
+    }
+    // fully reinitialize - ping shares storage with the class C window
+    os_clearMem(&s->ping, sizeof(s->ping));
+    s->mode         = MC_CLASS_B;
+    s->ping.intvExp = intvExp;
+    s->ping.freq    = freq ?: REGION.pingFreq;
+    s->ping.dr      = dr;
+    s->ping.rxtime  = os_getTime();
+    s->ping.slot    = 128;      // nothing scheduled in current beacon period
+    return 1;
+}
+#endif
+
+// Schedule class C window of multicast group: continuous RX on freq/dr from
+// start for secs seconds (up to 2^15, the maximum SessionTimeout of the
+// remote multicast setup package), secs=0 cancels the window. Replaces any
+// class B ping slots, outside of the window the group is served in class A.
+int LMIC_setMultiCastClassC (devaddr_t grpaddr, ostime_t start, u4_t secs, freq_t freq, dr_t dr) {
+    session_t* s;
+    for(s = LMIC.sessions; s<LMIC.sessions+MAX_MULTICAST_SESSIONS && s->grpaddr!=grpaddr; s++);
+    if( grpaddr == 0 || s >= LMIC.sessions+MAX_MULTICAST_SESSIONS )
+        return 0;
+    ASSERT(secs <= (1 << 15));
+    if( secs == 0 ) {
+        if( s->mode == MC_CLASS_C )
+            s->mode = MC_CLASS_A;
+        engineUpdate();
+        return 1;
+    }
+    s->mode   = MC_CLASS_C;
+    s->ccBeg  = start;
+    s->ccEnd  = start + sec2osticks(secs);
+    s->ccFreq = freq;
+    s->ccDr   = dr;
+    engineUpdate();
+    return 1;
+}
+
 // Enable/disable link check validation.
 // LMIC sets the ADRACKREQ bit in UP frames if there were no DN frames
 // for a while. It expects the network to provide a DN message to prove
@@ -3502,6 +3878,11 @@ void LMIC_disableDC (void) {
     LMIC.noDC = 1;
 }
 
+// Use CAD for RX windows and/or listen-before-talk (CAD_RXWIN|CAD_LBT)
+void LMIC_setCadMode (u1_t mode) {
+    LMIC.cadMode = mode;
+}
+
 #if defined(CFG_simul)
 #include "addr2func.h"
 #include "arr2len.h"
@@ -27,13 +27,17 @@ extern "C"{
 // ------------------------------------------------
 // BEGIN -- MULTI REGION
 
-// band
+// band (edges in BAND_FREQ_UNIT to keep region tables small)
 typedef struct {
-    freq_t      lo, hi;
+    u2_t        lo, hi;       // band edges (BAND_FREQ units)
     u2_t        txcap;
     s1_t        txpow;
 } band_t;
 
+#define BAND_FREQ_UNIT  50000
+// (constant f only - fails to compile if f is not on the BAND_FREQ_UNIT grid)
+#define BAND_FREQ(f)    ((f) / BAND_FREQ_UNIT + 0 * sizeof(char[((f) % BAND_FREQ_UNIT == 0) ? 1 : -1]))
+
 #define MAX_BANDS       8
 #define BAND_MASK       (MAX_BANDS-1)
 #if (MAX_BANDS & BAND_MASK) != 0
@@ -94,9 +98,8 @@ typedef struct {
 } rfuncs_t;
 
 // Immutable region definition
-// TODO: reorder struct members to optimize padding
+// (members ordered by alignment to avoid padding - regions use designated initializers)
 typedef struct {
-    u4_t flags;
     union {
         // dynamic channels
         struct {
@@ -105,7 +108,8 @@ typedef struct {
             u2_t        chTxCap;                        // per-channel DC
             u2_t        ccaTime;                        // CCA time (ticks)
             s1_t        ccaThreshold;                   // CCA threshold
-            band_t      bands[MAX_BANDS];               // band definitions
+            u1_t        numBands;                       // number of bands (<= MAX_BANDS)
+            const band_t* bands;                        // band definitions
         };
 
         // fixed channels
@@ -126,12 +130,13 @@ typedef struct {
     freq_t              minFreq, maxFreq;       // legal frequency range
     freq_t              rx2Freq;                // RX2 frequency
     freq_t              pingFreq;               // ping frequency
+    ostime_t            beaconAirtime;          // beacon air time
+    u1_t                flags;                  // REG_FIXED, REG_PSA
     dr_t                rx2Dr;                  // RX2 data rate
     dr_t                pingDr;                 // ping data rate
     dr_t                beaconDr;               // beacon data rate
     u1_t                beaconOffInfo;          // offset beacon info field
     u1_t                beaconLen;              // beacon length
-    ostime_t            beaconAirtime;          // beacon air time
     eirp_t              maxEirp;                // max. EIRP (initial value)
     s1_t                rx1DrOff[8];            // RX1 data rate offsets
     u1_t                dr2maxAppPload[16];     // max application payload (assuming no repeater and no fopts)
@@ -176,7 +181,7 @@ typedef struct {
     u1_t     intvExp;   // bits: 7:pend, 3:illegal intv, 2-0:intv
     u1_t     slot;      // runs from 0 to 128
     u1_t     rxsyms;
-    ostime_t rxbase;
+    ostime_t rxbase;    // start of slot 0 (incl. RX window offset, excl. drift)
     ostime_t rxtime;    // start of next spot
     u4_t     freq;
 } rxsched_t;
@@ -203,7 +208,13 @@ typedef struct {
 
 
 // purpose of receive window - lmic_t.rxState
-enum { RADIO_STOP=0, RADIO_TX=1, RADIO_RX=2, RADIO_RXON=3, RADIO_TXCW, RADIO_CCA, RADIO_INIT, RADIO_CAD, RADIO_TXCONT };
+enum { RADIO_STOP=0, RADIO_TX=1, RADIO_RX=2, RADIO_RXON=3, RADIO_TXCW, RADIO_CCA, RADIO_INIT, RADIO_CAD, RADIO_TXCONT,
+       RADIO_RXCAD,     // like RADIO_RX but start with CAD - keep receiver on only if preamble detected
+       RADIO_CCACAD };  // CAD based CCA - LMIC.rssi set to CAD_RSSI_BUSY if LoRa activity detected
+enum { CAD_RSSI_BUSY = 127, CAD_RSSI_CLEAR = -128 };
+// CAD usage (lmic_t.cadMode)
+enum { CAD_RXWIN = 0x01,   // use CAD-first RX for RX1/RX2 and ping slots
+       CAD_LBT   = 0x02 }; // CAD based listen-before-talk before each uplink
 // Netid values /  lmic_t.netid
 enum { NETID_NONE=~0U, NETID_MASK=0xFFFFFF };
 // MAC operation modes (lmic_t.opmode).
@@ -272,13 +283,35 @@ enum {
     UNILATERAL_CLASS_C = 2,
 };
 
+// multicast session modes - session_t.mode
+enum { MC_CLASS_A = 0,    // class A only
+       MC_CLASS_B = 1,    // class B ping slots
+       MC_CLASS_C = 2 };  // class C window
+
+// Session keys are kept in LMIC.lceCtx.mcgroup only. A group uses either
+// class B ping slots or a class C window, so their state is overlapped.
 typedef struct {
     devaddr_t   grpaddr;      // multicast group address
-    u1_t        nwkKeyDn[16]; // network session key for down-link
-    u1_t        appKey[16];   // application session key
     u4_t        seqnoADn;     // down stream seqno (AFCntDown)
+    union {
+#if !defined(DISABLE_CLASSB)
+        rxsched_t   ping;     // class B ping slots
+#endif
+        struct {
+            ostime_t    ccBeg;    // class C window start
+            ostime_t    ccEnd;    // class C window end
+            u4_t        ccFreq;   // class C window frequency
+            u1_t        ccDr;     // class C window data rate
+        };
+    };
+    u1_t        mode;         // MC_CLASS_A/B/C
 } session_t;
 
+// Just-in-time payload writer - called once per uplink right before the frame is
+// built (after channel selection and LBT). Gets the queued payload in data and the
+// room left at the current DR in dlen, updates data in place, returns its length (<= dlen).
+typedef int (*txjit_t) (u1_t* data, int dlen);
+
 // duty cycle/dwell time relative to baseAvail in sec.
 // To avoid roll over this needs to be updated.
 typedef u2_t avail_t;
@@ -300,12 +333,16 @@ struct lmic_t {
     u1_t        rxsyms;
     u1_t        dndr;
     s1_t        txpow;     // dBm -- needs to be combined with brdTxPowOff
+    u1_t        refChnl;         // channel randomizer - search relative to this indicator
+    u1_t        txChnl;          // channel for next TX
+    u1_t        globalDutyRate;  // max rate: 1/2^k
 
     osjob_t     osjob;
 
-    osxtime_t   baseAvail;                      // base time for availability
     avail_t     globalAvail;                    // next available DC (global)
     u1_t        noDC;                           // disable all duty cycle
+    u1_t        cadMode;                        // CAD_RXWIN / CAD_LBT
+    osxtime_t   baseAvail;                      // base time for availability
 
     const region_t* region;
     union {
@@ -319,20 +356,24 @@ struct lmic_t {
             drmap_t     chDrMap[MAX_DYN_CHNLS]; // enabled data rates
 
             u2_t        channelMap;             // active channels
+
+            // channel selection index (maintained by setupChannel/disableChannel/updateTx)
+            u2_t        drChnls[16];            // defined channels per data rate
+            u2_t        bandChnls[MAX_BANDS];   // defined channels per band
+            avail_t     bandChAvail[MAX_BANDS]; // earliest expiry of per-channel DC (per band)
+            u2_t        chBusy;                 // channels blocked by per-channel DC
         } dyn;
 #endif
 #ifdef REG_FIX
         // FCC-like (fixed channels)
         struct {
             u2_t        channelMap[CHMAP_SZ];           // enabled bits
-            u1_t        hoplist[MAX_FIX_CHNLS_125];     // hoplist
+            u1_t        hoplist[MAX_FIX_CHNLS_125];     // hoplist (enabled channels first)
+            u1_t        hopcnt;                         // enabled channels in hoplist (HOPCNT_STALE - rebuild)
         } fix;
 #endif
     };
 
-    u1_t        refChnl;         // channel randomizer - search relative to this indicator
-    u1_t        txChnl;          // channel for next TX
-    u1_t        globalDutyRate;  // max rate: 1/2^k
     ostime_t    globalDutyAvail; // time device can send again  -- XXX:PROBLEM if no TX for ~18h we have a rollover here!! --> avail_t??
 
     u4_t        netid;        // current network id (~0 - none)
@@ -357,9 +398,11 @@ struct lmic_t {
     u1_t        pendTxLen;    // +0x80 = confirmed
     u1_t        pendTxData[MAX_LEN_PAYLOAD];
     u1_t        pendTxNoRx;   // don't listen for down data after tx
+    const u1_t* pendTxBuf;    // caller-owned payload (NULL: pendTxData) - must stay unchanged until EV_TXCOMPLETE
+    txjit_t     pendTxJit;    // refresh payload at TX time (NULL: none) - cleared after use
 
-    u2_t        devNonce;     // last generated nonce
     lce_ctx_t   lceCtx;
+    u2_t        devNonce;     // last generated nonce
     devaddr_t   devaddr;
     u4_t        seqnoDn;      // device level down stream seqno
 #if defined(CFG_lorawan11)
@@ -367,31 +410,31 @@ struct lmic_t {
 #endif
     u4_t        seqnoUp;
 
-    u1_t        dnConf;       // dn frame confirm pending: LORA::FCT_ACK or 0
     s4_t        adrAckReq;    // counter until we reset data rate (0x80000000=off)
     u4_t        adrAckLimit;  // ADR_ACK_LIMIT
     u4_t        adrAckDelay;  // ADR_ACK_DELAY
+    u4_t        dn2Freq;      // 2nd RX window (after up stream)
+    u4_t        dnfqAcks;     // ack bit pending
 
     u1_t        margin;       // bits 7/6:RFU, 0-5: SNR of last DevStatusReq frame, reported by DevStatusAns to network
     u1_t        gwmargin;     // last reported by network via LinkCheckAns
     u1_t        gwcnt;        //  - ditto -
     u1_t        foptsUpLen;
     u1_t        foptsUp[64];  // pending FOpts in up direction - cleared after next send
-    bit_t       devsAns;      // device status answer pending
+    u1_t        dnConf;       // dn frame confirm pending: LORA::FCT_ACK or 0
+    bit_t       devsAns:1;    // device status answer pending
+    bit_t       dutyCapAns:1; // have to ACK duty cycle settings
     u1_t        adrEnabled;
     u1_t        moreData;     // NWK has more data pending
-    bit_t       dutyCapAns;   // have to ACK duty cycle settings
     //XXX:old: u1_t        snchAns;      // answer set new channel
     u1_t        dn1Dly;       // delay in secs to DNW1
     s1_t        dn1DrOffIdx;  // index into DR offset table (can be negative in some regions!)
     // 2nd RX window (after up stream)
     u1_t        dn2Dr;
-    u4_t        dn2Freq;
     u1_t        dn2Ans;       // 0=no answer pend, 0x80+ACKs
     u1_t        dn1DlyAns;    // 0=no answer pend, 0x80 send MCMD_RXTM_ANS
     u1_t        dnfqAns;      // # of DNFQ in this down frame
     u1_t        dnfqAnsPend;  // pending ACK bits (2 each)
-    u4_t        dnfqAcks;     // ack bit pending
 
     // multicast sessions
     session_t  sessions[MAX_MULTICAST_SESSIONS];
@@ -402,15 +445,16 @@ struct lmic_t {
 
 #if !defined(DISABLE_CLASSB)
     // Class B state
+    rxsched_t   ping;         // pingable setup
     u1_t        missedBcns;   // unable to track last N beacons
     s1_t        askForTime;   // how often to ask for time
     //XXX:old: u1_t        pingSetAns;   // answer set cmd and ACK bits
-    rxsched_t   ping;         // pingable setup
 #endif
 
     // Public part of MAC state
     u1_t        txCnt;
     u1_t        txrxFlags;  // transaction flags (TX-RX combo)
+    s1_t        dnMcgrp;    // multicast group of received frame (-1 if unicast)
     u1_t        dataBeg;    // 0 or start of data (dataBeg-1 is port)
     u1_t        dataLen;    // 0 no data or zero length data, >0 byte count of data
     u1_t        frame[MAX_LEN_FRAME];
@@ -419,15 +463,16 @@ struct lmic_t {
     u1_t        bcnfAns;      // mcmd beacon freq: bit7:pending, bit0:ACK/NACK
     u1_t        bcnChnl;
     u4_t        bcnFreq;      // 0=default, !=0: specific BCN freq/no hopping
-    u1_t        bcnRxsyms;    //
     ostime_t    bcnRxtime;
     bcninfo_t   bcninfo;      // Last received beacon info
+    u1_t        bcnRxsyms;    //
 #endif
 
     u1_t        noRXIQinversion;
 
     // automatic sending of MAC uplinks without payload
     osjob_t     polljob;      // job to schedule engineUpdate in poll mode
+    osjob_t     mccjob;       // job at class C multicast window start/end
     ostime_t    polltime;     // time when OP_POLL flag was set
     ostime_t    polltimeout;  // timeout when frame will be sent even without payload (default 0)
 
@@ -538,6 +583,7 @@ int   LMIC_regionIdx    (u1_t regionCode);
 u1_t  LMIC_regionCode   (u1_t regionIdx);
 void  LMIC_clrTxData    (void);
 void  LMIC_setTxData    (void);
+void  LMIC_setTxDataBuf (const u1_t* buf);
 int   LMIC_setTxData2   (u1_t port, u1_t* data, u1_t dlen, u1_t confirmed);
 void  LMIC_sendAlive    (void);
 
@@ -558,6 +604,10 @@ int  LMIC_scan (ostime_t timeout);
 int  LMIC_track (ostime_t when);
 #endif
 int LMIC_setMultiCastSession (devaddr_t grpaddr, const u1_t* nwkKeyDn, const u1_t* appKey, u4_t seqnoAdn);
+#if !defined(DISABLE_CLASSB)
+int LMIC_setMultiCastPing (devaddr_t grpaddr, u1_t intvExp, freq_t freq, dr_t dr);
+#endif
+int LMIC_setMultiCastClassC (devaddr_t grpaddr, ostime_t start, u4_t secs, freq_t freq, dr_t dr);
 
 void LMIC_setSession (u4_t netid, devaddr_t devaddr, const u1_t* nwkKey,
 #if defined(CFG_lorawan11)
@@ -576,6 +626,7 @@ ostime_t LMIC_calcAirTime (rps_t rps, u1_t plen);
 u1_t     LMIC_maxAppPayload();
 ostime_t LMIC_nextTx (ostime_t now);
 void     LMIC_disableDC (void);
+void     LMIC_setCadMode (u1_t mode);
 
 // Simulation only APIs
 #if defined(CFG_simul)
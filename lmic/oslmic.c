@@ -37,6 +37,11 @@ void rng_init (void) {
 #ifdef PERIPH_TRNG
     trng_next(OS.randwrds, 4);
 #elif defined(BRD_sx1261_radio) || defined(BRD_sx1262_radio)
+#if defined(BRD_multi_radio)
+    // (fallback if detected radio has no random number generator)
+    memcpy(OS.randbuf, __TIME__, 8);
+    os_getDevEui(OS.randbuf + 8);
+#endif
     radio_generate_random(OS.randwrds, 4);
 #else
     memcpy(OS.randbuf, __TIME__, 8);
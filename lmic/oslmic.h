@@ -168,7 +168,7 @@ u1_t os_getRndU1 (void);
 #ifndef RX_RAMPUP
 #ifndef CFG_rxrampup
 #if defined(BRD_sx1261_radio) || defined(BRD_sx1262_radio)
-#define RX_RAMPUP  (us2osticks(5000))
+#define RX_RAMPUP  (radio_rxrampup()) // (measured, shorter with retained config)
 #elif defined(BRD_sx1272_radio) || defined(BRD_sx1276_radio)
 #define RX_RAMPUP  (us2osticksCeil(2800))
 #else
@@ -368,8 +368,63 @@ void radio_startrx (bool rxcontinuous);
 void radio_sleep (void);
 void radio_cca (void);
 void radio_cad (void);
+void radio_rxcad (void);
+void radio_ccacad (void);
 void radio_cw (void);
 void radio_generate_random (u4_t *words, u1_t len);
+ostime_t radio_rxrampup (void); // (used by RX_RAMPUP, if provided by radio driver)
+
+#if defined(BRD_multi_radio)
+// Hybrid builds (BRD_multi_radio plus one SX127x and one SX126x BRD_xxx_radio)
+// compile both drivers and select the attached chip at runtime in radio_init().
+// The driver functions are then only reachable via these operation tables.
+typedef struct {
+    bool (*probe) (void); // reset radio and check presence of chip
+    void (*init) (bool calibrate);
+    bool (*irq_process) (ostime_t irqtime, u1_t diomask);
+    void (*starttx) (bool txcontinuous);
+    void (*startrx) (bool rxcontinuous);
+    void (*sleep) (void);
+    void (*cca) (void);
+    void (*cad) (void);
+    void (*rxcad) (void);
+    void (*ccacad) (void);
+    void (*cw) (void);
+    void (*generate_random) (u4_t *words, u1_t len); // (NULL if not supported)
+    ostime_t (*rxrampup) (void);
+} radio_ops_t;
+
+extern const radio_ops_t radio_ops_sx127x;
+extern const radio_ops_t radio_ops_sx126x;
+
+// renamed driver entry points (radio-sx127x.c)
+void sx127x_init (bool calibrate);
+bool sx127x_irq_process (ostime_t irqtime, u1_t diomask);
+void sx127x_starttx (bool txcontinuous);
+void sx127x_startrx (bool rxcontinuous);
+void sx127x_sleep (void);
+void sx127x_cca (void);
+void sx127x_cad (void);
+void sx127x_rxcad (void);
+void sx127x_ccacad (void);
+void sx127x_cw (void);
+void sx127x_writeBuf (u1_t addr, u1_t* buf, u1_t len);
+void sx127x_readBuf (u1_t addr, u1_t* buf, u1_t len);
+
+// renamed driver entry points (radio-sx126x.c)
+void sx126x_init (bool calibrate);
+bool sx126x_irq_process (ostime_t irqtime, u1_t diomask);
+void sx126x_starttx (bool txcontinuous);
+void sx126x_startrx (bool rxcontinuous);
+void sx126x_sleep (void);
+void sx126x_cca (void);
+void sx126x_cad (void);
+void sx126x_rxcad (void);
+void sx126x_ccacad (void);
+void sx126x_cw (void);
+void sx126x_generate_random (u4_t *words, u1_t len);
+ostime_t sx126x_rxrampup (void);
+#endif // defined(BRD_multi_radio)
 
 #ifdef __cplusplus
 } // extern "C"
@@ -43,6 +43,12 @@ void usart_recv (usart_rx_func rx, void* arg);
 void usart_send (usart_tx_func tx, void* arg);
 void usart_abort_recv (void);
 
+// DMA reception into ring buffer, job is run at end of frame (idle line) and at half/full buffer
+void usart_recv_dma (unsigned char* ring, unsigned int size, osjob_t* job, osjobcb_t cb);
+unsigned int usart_read (unsigned char* dst, unsigned int len); // (returns number of bytes)
+// DMA transmission of buffer, job is run after last byte has been sent
+void usart_send_dma (const unsigned char* buf, unsigned int len, osjob_t* job, osjobcb_t cb);
+
 #endif
 
 
@@ -101,6 +107,24 @@ enum {
 };
 
 typedef void (*i2c_cb) (int status);
+
+// transaction descriptor (write wlen bytes from wbuf, then read rlen bytes into rbuf with repeated start)
+typedef struct i2c_txn {
+    struct i2c_txn* next;       // (used by driver)
+    unsigned int addr;
+    unsigned char* wbuf;
+    unsigned int wlen;          // (max 255)
+    unsigned char* rbuf;
+    unsigned int rlen;          // (max 255)
+    int status;                 // I2C_BUSY until completed
+    osjob_t* job;               // job to run on completion (NULL: call cb from interrupt, if set)
+    osjobcb_t cb;
+} i2c_txn;
+
+// queue transaction, transactions are executed back-to-back
+// (a transaction must not be queued again before it has completed)
+void i2c_queue (i2c_txn* t);
+// single transfer, only one at a time (i2c_xfer and i2c_xfer_ex share state)
 void i2c_xfer (unsigned int addr, unsigned char* buf, unsigned int wlen, unsigned int rlen,
         i2c_cb cb, ostime_t timeout);
 void i2c_xfer_ex (unsigned int addr, unsigned char* buf, unsigned int wlen, unsigned int rlen,
@@ -114,7 +138,20 @@ void i2c_abort (void);
 // ------------------------------------------------
 // Analog-to-Digital Converter
 
+enum {
+    ADC_BUSY    = 1,
+    ADC_OK      = 0,
+    ADC_ERROR   = -1,
+    ADC_ABORT   = -2,
+};
+
+// single conversion (must not be called while an adc_read_ex() scan is pending)
 unsigned int adc_read (unsigned int chnl, unsigned int rate);
+// convert all channels in chmask once (ascending order, one result per channel in buf),
+// with hardware oversampling of 2^ovs samples per result (0=off); job is run on completion
+void adc_read_ex (unsigned int chmask, unsigned int rate, unsigned int ovs, u2_t* buf,
+        osjob_t* job, osjobcb_t cb, int* pstatus);
+void adc_abort (void);
 
 #endif
 
@@ -10,6 +10,22 @@
 
 #if defined(BRD_sx1261_radio) || defined(BRD_sx1262_radio)
 
+#if defined(BRD_multi_radio)
+// hybrid build: export driver via radio_ops_sx126x only
+#define radio_init              sx126x_init
+#define radio_irq_process       sx126x_irq_process
+#define radio_starttx           sx126x_starttx
+#define radio_startrx           sx126x_startrx
+#define radio_sleep             sx126x_sleep
+#define radio_cca               sx126x_cca
+#define radio_cad               sx126x_cad
+#define radio_rxcad             sx126x_rxcad
+#define radio_ccacad            sx126x_ccacad
+#define radio_cw                sx126x_cw
+#define radio_generate_random   sx126x_generate_random
+#define radio_rxrampup          sx126x_rxrampup
+#endif // defined(BRD_multi_radio)
+
 // ----------------------------------------
 // Commands Selecting the Operating Modes of the Radio
 #define CMD_SETSLEEP                    0x84
@@ -109,6 +125,11 @@
 #define PACKET_TYPE_FSK         0x00
 #define PACKET_TYPE_LORA        0x01
 
+// cad symbols and exit modes
+#define CAD_ON_2_SYMB           0x01
+#define CAD_ONLY                0x00
+#define CAD_RX                  0x01
+
 // crc types
 #define CRC_OFF                 0x01
 #define CRC_1_BYTE              0x00
@@ -170,9 +191,38 @@ static const u2_t LORA_RXDONE_FIXUP_500[] = {
     [SF12] = us2osticks(    0),
 };
 
+// cached configuration items (retained during warm sleep)
+enum {
+    CFG_COMMON   = (1 << 0),  // regulator mode, DIO2/DIO3 control
+    CFG_PTYPE    = (1 << 1),  // packet type
+    CFG_FREQ     = (1 << 2),  // rf frequency
+    CFG_MOD      = (1 << 3),  // modulation parameters
+    CFG_PKT      = (1 << 4),  // packet parameters
+    CFG_TXPOW    = (1 << 5),  // PA config and tx parameters
+    CFG_DIOIRQ   = (1 << 6),  // irq and dio masks
+    CFG_SYMTO    = (1 << 7),  // LoRa symbol timeout
+    CFG_STOPTMR  = (1 << 8),  // stop timer on preamble
+    CFG_REGSLORA = (1 << 9),  // LoRa registers (sync word)
+    CFG_REGSFSK  = (1 << 10), // FSK registers (sync word, crc, whitening)
+};
+
 // radio state
 static struct {
     unsigned int sleeping:1;
+    unsigned int cadrx:1;   // CAD-first rx window (single rx on detection)
+    ostime_t cadend;        // last CAD start of rx window
+    ostime_t rxrampup;      // rx ramp-up time measured with retained configuration
+    u2_t cfgvalid;          // valid cached configuration items (CFG_xxx)
+    struct {
+        uint8_t ptype;
+        uint8_t freq[4];
+        uint8_t mod[8];
+        uint8_t pkt[9];
+        uint8_t txpow[2];
+        uint8_t dioirq[8];
+        uint8_t symto;
+        uint8_t stoptmr;
+    } cfg;                  // last written configuration parameters
 } state;
 
 // ----------------------------------------
@@ -190,6 +240,15 @@ static void writecmd (uint8_t cmd, const uint8_t* data, uint8_t len) {
     // eventually during a subsequent hal_spi_select(1)...
 }
 
+// write configuration command, unless the radio still has identical parameters
+static void writecfg (u2_t item, uint8_t* cache, uint8_t cmd, const uint8_t* data, uint8_t len) {
+    if ((state.cfgvalid & item) == 0 || memcmp(cache, data, len) != 0) {
+        writecmd(cmd, data, len);
+        os_copyMem(cache, data, len);
+        state.cfgvalid |= item;
+    }
+}
+
 static void WriteRegs (uint16_t addr, const uint8_t* data, uint8_t len) {
     hal_spi_select(1);
     hal_pin_busy_wait();
@@ -340,9 +399,34 @@ static void SetFs (void) {
     writecmd(CMD_SETFS, NULL, 0);
 }
 
+// start channel activity detection (CadDone, CadDetected)
+static void SetCad (void) {
+    writecmd(CMD_SETCAD, NULL, 0);
+}
+
+// configure CAD for 2 symbols, no automatic rx (peak thresholds per SF, see AN1200.48)
+static void SetCadParams (u2_t rps) {
+    static const uint8_t detpeak[] = {
+        [SF7] = 22, [SF8] = 22, [SF9] = 23, [SF10] = 24, [SF11] = 25, [SF12] = 28,
+    };
+    uint8_t param[7] = { CAD_ON_2_SYMB, detpeak[getSf(rps)], 10, CAD_ONLY, 0, 0, 0 };
+    writecmd(CMD_SETCADPARAMS, param, 7);
+}
+
+// get instantaneous rssi (in rx mode)
+static s2_t GetRssiInst (void) {
+    uint8_t buf[1];
+    readcmd(CMD_GETRSSIINST, buf, 1);
+    return -buf[0] / 2 + RSSI_OFF;
+}
+
 // set radio to PACKET_TYPE_LORA or PACKET_TYPE_FSK mode
 static void SetPacketType (uint8_t type) {
-    writecmd(CMD_SETPACKETTYPE, &type, 1);
+    if ((state.cfgvalid & CFG_PTYPE) == 0 || state.cfg.ptype != type) {
+        // modulation and packet parameters depend on packet type
+        state.cfgvalid &= ~(CFG_MOD | CFG_PKT);
+    }
+    writecfg(CFG_PTYPE, &state.cfg.ptype, CMD_SETPACKETTYPE, &type, 1);
 }
 
 // calibrate the image rejection
@@ -370,7 +454,7 @@ static void SetRfFrequency (uint32_t freq) {
     // set frequency
     uint8_t buf[4];
     os_wmsbf4(buf, (uint32_t) (((uint64_t) freq << 25) / 32000000));
-    writecmd(CMD_SETRFFREQUENCY, buf, 4);
+    writecfg(CFG_FREQ, state.cfg.freq, CMD_SETRFFREQUENCY, buf, 4);
 }
 
 // configure modulation parameters for LoRa
@@ -380,7 +464,7 @@ static void SetModulationParamsLora (u2_t rps) {
     param[1] = getBw(rps) - BW125 + 4;  // BW (bw125 -> 4)
     param[2] = getCr(rps) - CR_4_5 + 1; // CR (cr45 -> 1)
     param[3] = enDro(rps);     // low-data-rate-opt (symbol time equal or above 16.38 ms)
-    writecmd(CMD_SETMODULATIONPARAMS, param, 4);
+    writecfg(CFG_MOD, state.cfg.mod, CMD_SETMODULATIONPARAMS, param, 4);
 }
 
 // configure modulation parameters for FSK
@@ -394,7 +478,7 @@ static void SetModulationParamsFsk (void) {
     param[5] = 0x00; // TX frequency deviation 25kHz (deviation * 2^25 / fxtal = 25000 * 2^25 / 32000000 = 0x006666)
     param[6] = 0x66;
     param[7] = 0x66;
-    writecmd(CMD_SETMODULATIONPARAMS, param, 8);
+    writecfg(CFG_MOD, state.cfg.mod, CMD_SETMODULATIONPARAMS, param, 8);
 }
 
 // configure packet handling for LoRa
@@ -406,7 +490,7 @@ static void SetPacketParamsLora (u2_t rps, int len, int inv) {
     param[3] = len;
     param[4] = !getNocrc(rps);
     param[5] = inv; // I/Q inversion
-    writecmd(CMD_SETPACKETPARAMS, param, 6);
+    writecfg(CFG_PKT, state.cfg.pkt, CMD_SETPACKETPARAMS, param, 6);
 }
 
 // configure packet handling for FSK
@@ -421,7 +505,7 @@ static void SetPacketParamsFsk (u2_t rps, int len) {
     param[6] = len;  // payload length
     param[7] = getNocrc(rps) ? CRC_OFF : CRC_2_BYTE_INV; // off or CCITT
     param[8] = 0x01; // whitening enabled
-    writecmd(CMD_SETPACKETPARAMS, param, 9);
+    writecfg(CFG_PKT, state.cfg.pkt, CMD_SETPACKETPARAMS, param, 9);
 }
 
 // clear irq register
@@ -432,12 +516,12 @@ static void ClearIrqStatus (uint16_t mask) {
 
 // stop timer on preamble detection or header/syncword detection
 static void StopTimerOnPreamble (uint8_t enable) {
-    writecmd(CMD_STOPTIMERONPREAMBLE, &enable, 1);
+    writecfg(CFG_STOPTMR, &state.cfg.stoptmr, CMD_STOPTIMERONPREAMBLE, &enable, 1);
 }
 
 // set number of symbols for reception
 static void SetLoRaSymbNumTimeout (uint8_t nsym) {
-    writecmd(CMD_SETLORASYMBNUMTIMEOUT, &nsym, 1);
+    writecfg(CFG_SYMTO, &state.cfg.symto, CMD_SETLORASYMBNUMTIMEOUT, &nsym, 1);
 }
 
 // return irq register
@@ -465,7 +549,7 @@ static s1_t GetPacketStatusFsk (void) {
 // set and enable irq mask for dio1
 static void SetDioIrqParams (uint16_t mask) {
     uint8_t param[] = { mask >> 8, mask & 0xFF, mask >> 8, mask & 0xFF, 0x00, 0x00, 0x00, 0x00 };
-    writecmd(CMD_SETDIOIRQPARAMS, param, 8);
+    writecfg(CFG_DIOIRQ, state.cfg.dioirq, CMD_SETDIOIRQPARAMS, param, 8);
 }
 
 // set tx power (in dBm)
@@ -474,20 +558,24 @@ static void SetTxPower (int pw) {
     // low power PA: -17 ... +14 dBm
     if (pw > 14) pw = 14;
     if (pw < -17) pw = -17;
-    // set PA config (and reset OCP to 60mA)
-    writecmd(CMD_SETPACONFIG, (const uint8_t[]) { 0x04, 0x00, 0x01, 0x01 }, 4);
+    // PA config (and reset OCP to 60mA)
+    static const uint8_t paconfig[] = { 0x04, 0x00, 0x01, 0x01 };
 #elif defined(BRD_sx1262_radio)
     // high power PA: -9 ... +22 dBm
     if (pw > 22) pw = 22;
     if (pw < -9) pw = -9;
-    // set PA config (and reset OCP to 140mA)
-    writecmd(CMD_SETPACONFIG, (const uint8_t[]) { 0x04, 0x07, 0x00, 0x01 }, 4);
+    // PA config (and reset OCP to 140mA)
+    static const uint8_t paconfig[] = { 0x04, 0x07, 0x00, 0x01 };
 #endif
+    // set PA config (unless retained)
+    if ((state.cfgvalid & CFG_TXPOW) == 0) {
+        writecmd(CMD_SETPACONFIG, paconfig, 4);
+    }
     // set tx params
     uint8_t txparam[2];
     txparam[0] = (uint8_t) pw;
     txparam[1] = 0x04; // ramp time 200us
-    writecmd(CMD_SETTXPARAMS, txparam, 2);
+    writecfg(CFG_TXPOW, state.cfg.txpow, CMD_SETTXPARAMS, txparam, 2);
 }
 
 // set sync word for LoRa
@@ -522,20 +610,75 @@ static void SetCrc16 (uint16_t seed, uint16_t polynomial) {
 }
 
 void radio_sleep (void) {
-    // cache sleep state to avoid unneccessary wakeup (waking up from cold sleep takes about 4ms)
+    // cache sleep state to avoid unneccessary wakeup
+    // (warm sleep retains the configuration, wakeup takes about 340us instead of 4ms from cold sleep)
     if (state.sleeping == 0) {
-        SetSleep(SLEEP_COLD);
+        SetSleep(SLEEP_WARM);
         state.sleeping = 1;
     }
 }
 
-// Do config common to all RF modes
+// enter STDBY_RC mode (radio wakes up from sleep to STDBY_RC with next command)
+static void Standby (void) {
+    if (state.sleeping == 0) {
+        SetStandby(STDBY_RC);
+    }
+}
+
+// Do config common to all RF modes (unless retained)
 static void CommonSetup (void) {
-    SetRegulatorMode(REGMODE_DCDC);
-    if (hal_dio2_controls_rxtx())
-        SetDIO2AsRfSwitchCtrl(1);
-    if (hal_dio3_controls_tcxo())
-        SetDIO3AsTcxoCtrl();
+    if ((state.cfgvalid & CFG_COMMON) == 0) {
+        SetRegulatorMode(REGMODE_DCDC);
+        if (hal_dio2_controls_rxtx())
+            SetDIO2AsRfSwitchCtrl(1);
+        if (hal_dio3_controls_tcxo())
+            SetDIO3AsTcxoCtrl();
+        state.cfgvalid |= CFG_COMMON;
+    }
+}
+
+// set fixed LoRa registers (unless retained)
+static void SetupRegsLora (void) {
+    if ((state.cfgvalid & CFG_REGSLORA) == 0) {
+        SetSyncWordLora(0x3444);
+        state.cfgvalid |= CFG_REGSLORA;
+    }
+}
+
+// set fixed FSK registers (unless retained)
+static void SetupRegsFsk (void) {
+    if ((state.cfgvalid & CFG_REGSFSK) == 0) {
+        SetCrc16(0x1D0F, 0x1021); // CCITT
+        SetWhiteningSeed(0x01FF);
+        SetSyncWordFsk(0xC194C1);
+        state.cfgvalid |= CFG_REGSFSK;
+    }
+}
+
+// check and track rx ramp-up time (from start of configuration until radio is ready for rx)
+static void rxrampup (ostime_t t0, bool warm) {
+    ostime_t now = os_getTime();
+    if (LMIC.rxtime - now < 0) {
+        // Print before disabling IRQs, to work around deadlock on some
+        // Arduino cores that doe not really support printing without IRQs
+        debug_printf("WARNING: rxtime is %ld ticks in the past! (ramp-up time %ld ms / %ld ticks)\r\n",
+                     now - LMIC.rxtime, osticks2ms(now - t0), now - t0);
+    }
+    if (warm) {
+        // follow increases immediately, decreases slowly
+        ostime_t dt = now - t0;
+        if (dt > state.rxrampup) {
+            state.rxrampup = dt;
+        } else {
+            state.rxrampup -= (state.rxrampup - dt) >> 3;
+        }
+    }
+}
+
+ostime_t radio_rxrampup (void) {
+    // use conservative value until the configuration has been retained in sleep
+    // (margin covers job latency and LMIC processing before radio is started)
+    return (state.cfgvalid & CFG_COMMON) ? state.rxrampup + us2osticks(1000) : us2osticks(5000);
 }
 
 static uint32_t GetRandom (void) __attribute__((__unused__)); // Ok if unused
@@ -543,6 +686,7 @@ static uint32_t GetRandom (void) {
     uint32_t value;
 
     // Set up oscillator and rx/tx
+    Standby();
     CommonSetup();
 
     // continuous rx
@@ -557,14 +701,14 @@ static uint32_t GetRandom (void) {
 }
 
 static void txlora (void) {
+    Standby();
     CommonSetup();
-    SetStandby(STDBY_RC);
     SetPacketType(PACKET_TYPE_LORA);
     SetRfFrequency(LMIC.freq);
     SetModulationParamsLora(LMIC.rps);
     SetPacketParamsLora(LMIC.rps, LMIC.dataLen, 0);
     SetTxPower(LMIC.txpow + LMIC.brdTxPowOff);
-    SetSyncWordLora(0x3444);
+    SetupRegsLora();
     WriteFifo(LMIC.frame, LMIC.dataLen);
     ClearIrqStatus(IRQ_ALL);
     SetDioIrqParams(IRQ_TXDONE | IRQ_TIMEOUT);
@@ -581,15 +725,13 @@ static void txlora (void) {
 }
 
 static void txfsk (void) {
+    Standby();
     CommonSetup();
-    SetStandby(STDBY_RC);
     SetPacketType(PACKET_TYPE_FSK);
     SetRfFrequency(LMIC.freq);
     SetModulationParamsFsk();
     SetPacketParamsFsk(LMIC.rps, LMIC.dataLen);
-    SetCrc16(0x1D0F, 0x1021); // CCITT
-    SetWhiteningSeed(0x01FF);
-    SetSyncWordFsk(0xC194C1);
+    SetupRegsFsk();
     SetTxPower(LMIC.txpow + LMIC.brdTxPowOff);
     WriteFifo(LMIC.frame, LMIC.dataLen);
     ClearIrqStatus(IRQ_ALL);
@@ -607,8 +749,8 @@ static void txfsk (void) {
 }
 
 void radio_cw (void) {
+    Standby();
     CommonSetup();
-    SetStandby(STDBY_RC);
     SetRfFrequency(LMIC.freq);
     SetTxPower(LMIC.txpow + LMIC.brdTxPowOff);
     ClearIrqStatus(IRQ_ALL);
@@ -640,18 +782,25 @@ void radio_starttx (bool txcontinuous) {
     }
 }
 
+// (called by HAL at exact rx time, interrupts disabled)
+static void rxfskstart (void) {
+    // enable antenna switch for RX (and account power consumption)
+    hal_ant_switch(HAL_ANTSW_RX);
+    // rx for max LMIC.rxsyms symbols (rxsyms = nbytes for FSK)
+    SetRx((LMIC.rxsyms << 9) / 50); // nbytes * 8 * 64 * 1000 / 50000
+}
+
 static void rxfsk (bool rxcontinuous) {
-    // configure radio (needs rampup time)
+    // configure radio (needs rampup time, short if configuration was retained)
     ostime_t t0 = os_getTime();
+    bool warm = (state.cfgvalid & CFG_COMMON) != 0;
+    Standby();
     CommonSetup();
-    SetStandby(STDBY_RC);
     SetPacketType(PACKET_TYPE_FSK);
     SetRfFrequency(LMIC.freq);
     SetModulationParamsFsk();
     SetPacketParamsFsk(LMIC.rps, 255);
-    SetCrc16(0x1D0F, 0x1021); // CCITT
-    SetWhiteningSeed(0x01FF);
-    SetSyncWordFsk(0xC194C1);
+    SetupRegsFsk();
     StopTimerOnPreamble(0);
     // FSK interrupts: TXDONE, RXDONE, PREAMBLEDETECTED, SYNCWORDVALID, CRCERR, TIMEOUT
     SetDioIrqParams(IRQ_RXDONE | IRQ_TIMEOUT);
@@ -663,44 +812,52 @@ static void rxfsk (bool rxcontinuous) {
     // enable IRQs in HAL
     hal_irqmask_set(HAL_IRQMASK_DIO1);
 
-    ostime_t now = os_getTime();
-    if (!rxcontinuous && LMIC.rxtime - now < 0) {
-        debug_printf("WARNING: rxtime is %ld ticks in the past! (ramp-up time %ld ms / %ld ticks)\r\n",
-                     now - LMIC.rxtime, osticks2ms(now - t0), now - t0);
+    if (!rxcontinuous) {
+        rxrampup(t0, warm);
     }
 
-    // now receive (lock interrupts only for final fine tuned rx timing...)
-    hal_disableIRQs();
+    // now receive (radio is in FS mode, ready for immediate rx)
     if (rxcontinuous) { // continous rx
         BACKTRACE();
+        hal_disableIRQs();
         // enable antenna switch for RX (and account power consumption)
         hal_ant_switch(HAL_ANTSW_RX);
         // rx infinitely (no timeout, until rxdone, will be restarted)
         SetRx(0);
+        hal_enableIRQs();
     } else { // single rx
         BACKTRACE();
-        // busy wait until exact rx time
-        hal_waitUntil(LMIC.rxtime);
-        // enable antenna switch for RX (and account power consumption)
-        hal_ant_switch(HAL_ANTSW_RX);
-        // rx for max LMIC.rxsyms symbols (rxsyms = nbytes for FSK)
-        SetRx((LMIC.rxsyms << 9) / 50); // nbytes * 8 * 64 * 1000 / 50000
+        // start at exact rx time
+        hal_timedCall(LMIC.rxtime, rxfskstart);
     }
-    hal_enableIRQs();
 }
 
-static void rxlora (bool rxcontinuous) {
-    // configure radio (needs rampup time)
-    ostime_t t0 = os_getTime();
+// (called by HAL at exact rx time, interrupts disabled)
+static void rxlorastart (void) {
+    // enable antenna switch for RX (and account power consumption)
+    hal_ant_switch(HAL_ANTSW_RX);
+    // rx for max LMIC.rxsyms symbols
+    SetRx(0); // (infinite, timeout set via SetLoRaSymbNumTimeout)
+}
+
+// setup LoRa receiver (freq, modulation, packet, sync word, symbol timeout)
+static void setuprxlora (void) {
+    Standby();
     CommonSetup();
-    SetStandby(STDBY_RC);
     SetPacketType(PACKET_TYPE_LORA);
     SetRfFrequency(LMIC.freq);
     SetModulationParamsLora(LMIC.rps);
     SetPacketParamsLora(LMIC.rps, 255, !LMIC.noRXIQinversion);
-    SetSyncWordLora(0x3444);
+    SetupRegsLora();
     StopTimerOnPreamble(0);
     SetLoRaSymbNumTimeout(LMIC.rxsyms);
+}
+
+static void rxlora (bool rxcontinuous) {
+    // configure radio (needs rampup time, short if configuration was retained)
+    ostime_t t0 = os_getTime();
+    bool warm = (state.cfgvalid & CFG_COMMON) != 0;
+    setuprxlora();
     SetDioIrqParams(IRQ_RXDONE | IRQ_TIMEOUT);
 
     ClearIrqStatus(IRQ_ALL);
@@ -711,41 +868,162 @@ static void rxlora (bool rxcontinuous) {
     // enable IRQs in HAL
     hal_irqmask_set(HAL_IRQMASK_DIO1);
 
-    ostime_t now = os_getTime();
-    if (!rxcontinuous && LMIC.rxtime - now < 0) {
-        // Print before disabling IRQs, to work around deadlock on some
-        // Arduino cores that doe not really support printing without IRQs
-        debug_printf("WARNING: rxtime is %ld ticks in the past! (ramp-up time %ld ms / %ld ticks)\r\n",
-                     now - LMIC.rxtime, osticks2ms(now - t0), now - t0);
+    if (!rxcontinuous) {
+        rxrampup(t0, warm);
     }
 
-    // now receive (lock interrupts only for final fine tuned rx timing...)
-    hal_disableIRQs();
+    // now receive (radio is in FS mode, ready for immediate rx)
     if (rxcontinuous) { // continous rx
         BACKTRACE();
+        hal_disableIRQs();
         // enable antenna switch for RX (and account power consumption)
         hal_ant_switch(HAL_ANTSW_RX);
         // rx infinitely (no timeout, until rxdone, will be restarted)
         SetRx(0);
+        hal_enableIRQs();
     } else { // single rx
         BACKTRACE();
-        // busy wait until exact rx time
-        hal_waitUntil(LMIC.rxtime);
-        // enable antenna switch for RX (and account power consumption)
-        hal_ant_switch(HAL_ANTSW_RX);
-        // rx for max LMIC.rxsyms symbols
-        SetRx(0); // (infinite, timeout set via SetLoRaSymbNumTimeout)
+        // start at exact rx time
+        hal_timedCall(LMIC.rxtime, rxlorastart);
     }
-    hal_enableIRQs();
 }
 
-void radio_cca () {
-    LMIC.rssi = -127; //XXX:TBD
+// LoRa symbol time in osticks
+static ostime_t symticks (rps_t rps) {
+    return us2osticks(1 << (getSf(rps) - SF7 + 10 - getBw(rps)));
+}
+
+// (called by HAL at exact rx time, interrupts disabled)
+static void rxloracadstart (void) {
+    // enable antenna switch for RX (and account power consumption)
+    hal_ant_switch(HAL_ANTSW_RX);
+    // start CAD...
+    SetCad();
+}
+
+static void rxloracad (bool rxwin) {
+    ostime_t t0 = os_getTime();
+    bool warm = (state.cfgvalid & CFG_COMMON) != 0;
+    setuprxlora();
+    SetCadParams(LMIC.rps);
+    SetDioIrqParams(IRQ_CADDONE | IRQ_CADDETECTED | IRQ_RXDONE | IRQ_TIMEOUT);
+    ClearIrqStatus(IRQ_ALL);
+
+    // enable IRQs in HAL
+    hal_irqmask_set(HAL_IRQMASK_DIO1 | HAL_IRQMASK_FAST); // switch to rx on detection
+
+    BACKTRACE();
+    state.cadrx = rxwin;
+    if (rxwin) {
+        // repeat CAD until last symbol of rx window, then switch to single rx on detection
+        state.cadend = LMIC.rxtime + (LMIC.rxsyms - 1) * symticks(LMIC.rps);
+        rxrampup(t0, warm);
+        hal_timedCall(LMIC.rxtime, rxloracadstart);
+    } else {
+        // continuous rx after preamble detection
+        hal_disableIRQs();
+        rxloracadstart();
+        hal_enableIRQs();
+    }
+}
+
+// LMIC.rssi = max_rssi(threshold=LMIC.rssi, duration=LMIC.rxtime, freq=LMIC.freq, bw=LMIC.rps)
+void radio_cca (void) {
+    BACKTRACE();
+    Standby();
+    CommonSetup();
+    if (isFsk(LMIC.rps)) {
+        SetPacketType(PACKET_TYPE_FSK);
+        SetRfFrequency(LMIC.freq);
+        SetModulationParamsFsk();
+    } else {
+        SetPacketType(PACKET_TYPE_LORA);
+        SetRfFrequency(LMIC.freq);
+        SetModulationParamsLora(LMIC.rps);
+    }
+    SetDioIrqParams(0);
+
+    // enable antenna switch for RX (and account power consumption)
+    hal_ant_switch(HAL_ANTSW_RX);
+
+    // start receiver (continuous), don't care about frames
+    SetRx(0xFFFFFF);
+
+    // initialize threshold
+    int rssi;
+    int rssi_th = LMIC.rssi;
+    int rssi_max = -128 + RSSI_OFF;
+    ostime_t t0 = os_getTime();
+
+    // sample rssi values
+    do {
+        rssi = GetRssiInst();
+        if (rssi > rssi_max) {
+            rssi_max = rssi;
+        }
+    } while (rssi < rssi_th && os_getTime() - t0 < LMIC.rxtime);
+
+    // return max observed rssi value
+    LMIC.rssi = rssi_max;
+
+    // shutdown receiver
+    SetStandby(STDBY_RC);
+    ClearIrqStatus(IRQ_ALL);
+    radio_sleep();
+
+    // disable antenna switch
+    hal_ant_switch(HAL_ANTSW_OFF);
 }
 
 void radio_cad (void) {
-    // not yet...
-    ASSERT(0);
+    if (isFsk(LMIC.rps)) { // no CAD for FSK - continuous rx
+        radio_startrx(true);
+        return;
+    }
+    rxloracad(false);
+}
+
+void radio_rxcad (void) {
+    if (isFsk(LMIC.rps)) { // no CAD for FSK - regular rx window
+        radio_startrx(false);
+        return;
+    }
+    rxloracad(true);
+}
+
+// LMIC.rssi = CAD_RSSI_BUSY if LoRa preamble detected on freq=LMIC.freq, rps=LMIC.rps (else CAD_RSSI_CLEAR)
+void radio_ccacad (void) {
+    BACKTRACE();
+    setuprxlora();
+    SetCadParams(LMIC.rps);
+    // no HAL IRQs (polled)
+    SetDioIrqParams(IRQ_CADDONE | IRQ_CADDETECTED);
+    ClearIrqStatus(IRQ_ALL);
+
+    // enable antenna switch for RX (and account power consumption)
+    hal_ant_switch(HAL_ANTSW_RX);
+
+    // start CAD and wait for completion (takes about 2 symbols, radio returns to standby)
+    SetCad();
+    ostime_t t0 = os_getTime();
+    ostime_t tout = 4 * symticks(LMIC.rps);
+    uint16_t irqflags;
+    do {
+        irqflags = GetIrqStatus();
+    } while ((irqflags & IRQ_CADDONE) == 0 && os_getTime() - t0 < tout);
+
+    LMIC.rssi = (irqflags & IRQ_CADDETECTED) ? CAD_RSSI_BUSY : CAD_RSSI_CLEAR;
+
+    // mask and clear IRQs
+    SetStandby(STDBY_RC);
+    SetDioIrqParams(0);
+    ClearIrqStatus(IRQ_ALL);
+
+    // shutdown receiver
+    radio_sleep();
+
+    // disable antenna switch
+    hal_ant_switch(HAL_ANTSW_OFF);
 }
 
 void radio_startrx (bool rxcontinuous) {
@@ -758,6 +1036,9 @@ void radio_startrx (bool rxcontinuous) {
 
 // reset radio
 static void radio_reset (void) {
+    // configuration is lost (or unknown)
+    state.cfgvalid = 0;
+
     // drive RST pin low
     bool has_reset = hal_pin_rst(0);
 
@@ -885,6 +1166,24 @@ bool radio_irq_process (ostime_t irqtime, u1_t diomask) {
 #ifdef DEBUG_RX
             debug_printf("RX: TIMEOUT\r\n");
 #endif
+        } else if (irqflags & IRQ_CADDONE) { // CADDONE
+            BACKTRACE();
+            ClearIrqStatus(IRQ_ALL);
+            // check if preamble symbol was detected
+            if (irqflags & IRQ_CADDETECTED) {
+                // switch to receiving (single with symbol timeout in rx window, else continuous)
+                SetRx(state.cadrx ? 0 : 0xFFFFFF);
+                // continue waiting
+                return false;
+            } else if (state.cadrx && irqtime - state.cadend < 0) {
+                // nothing detected yet - repeat CAD until end of rx window
+                SetCad();
+                // continue waiting
+                return false;
+            } else {
+                // indicate timeout
+                LMIC.dataLen = 0;
+            }
         } else {
             // unexpected irq
             debug_printf("UNEXPECTED RADIO IRQ %04x\r\n", irqflags);
@@ -903,4 +1202,35 @@ bool radio_irq_process (ostime_t irqtime, u1_t diomask) {
     return true;
 }
 
+#if defined(BRD_multi_radio)
+// check for radio (reset and read sync word reset value)
+static bool sx126x_probe (void) {
+    hal_disableIRQs();
+    if (hal_pin_rst(0)) {
+        hal_waitUntil(os_getTime() + ms2osticks(1));
+        hal_pin_rst(2);
+        hal_waitUntil(os_getTime() + ms2osticks(1));
+    }
+    bool found = (ReadReg(REG_LORASYNCWORDLSB) == 0x24);
+    hal_enableIRQs();
+    return found;
+}
+
+const radio_ops_t radio_ops_sx126x = {
+    .probe = sx126x_probe,
+    .init = radio_init,
+    .irq_process = radio_irq_process,
+    .starttx = radio_starttx,
+    .startrx = radio_startrx,
+    .sleep = radio_sleep,
+    .cca = radio_cca,
+    .cad = radio_cad,
+    .rxcad = radio_rxcad,
+    .ccacad = radio_ccacad,
+    .cw = radio_cw,
+    .generate_random = radio_generate_random,
+    .rxrampup = radio_rxrampup,
+};
+#endif // defined(BRD_multi_radio)
+
 #endif
@@ -10,6 +10,22 @@
 
 #if defined(BRD_sx1272_radio) || defined(BRD_sx1276_radio)
 
+#if defined(BRD_multi_radio)
+// hybrid build: export driver via radio_ops_sx127x only
+#define radio_init              sx127x_init
+#define radio_irq_process       sx127x_irq_process
+#define radio_starttx           sx127x_starttx
+#define radio_startrx           sx127x_startrx
+#define radio_sleep             sx127x_sleep
+#define radio_cca               sx127x_cca
+#define radio_cad               sx127x_cad
+#define radio_rxcad             sx127x_rxcad
+#define radio_ccacad            sx127x_ccacad
+#define radio_cw                sx127x_cw
+#define radio_writeBuf          sx127x_writeBuf
+#define radio_readBuf           sx127x_readBuf
+#endif // defined(BRD_multi_radio)
+
 // ----------------------------------------
 // Registers Mapping
 #define RegFifo                                    0x00 // common
@@ -326,6 +342,9 @@ static struct {
     // large packet handling
     unsigned char* fifoptr;
     int fifolen;
+    // CAD-first rx window
+    bool cadrx;
+    ostime_t cadend;
 } state;
 
 // ----------------------------------------
@@ -696,7 +715,7 @@ static void txfsk (bool txcont) {
 
     if (!txcont) {
         // enable IRQs in HAL
-        hal_irqmask_set(HAL_IRQMASK_DIO0 | HAL_IRQMASK_DIO1);
+        hal_irqmask_set(HAL_IRQMASK_DIO0 | HAL_IRQMASK_DIO1 | HAL_IRQMASK_FAST); // FIFO refill
 
         // set tx timeout
         radio_set_irq_timeout(os_getTime() + us2osticks((u4_t)(FIFOTHRESH+10)*8*1000/50));
@@ -822,6 +841,14 @@ static ostime_t bugfix_rxtime (ostime_t rxtime) {
     return rxtime;
 }
 
+// (called by HAL at exact rx time, interrupts disabled)
+static void rxlorastart (void) {
+    // enable antenna switch for RX (and account power consumption)
+    hal_ant_switch(HAL_ANTSW_RX);
+    // rx now...
+    writeReg(RegOpMode, OPMODE_LORA_RX_SINGLE);
+}
+
 static void rxlorasingle (void) {
     ostime_t t0 = os_getTime();
 
@@ -841,23 +868,13 @@ static void rxlorasingle (void) {
     // enable IRQs in HAL
     hal_irqmask_set(HAL_IRQMASK_DIO0 | HAL_IRQMASK_DIO1);
 
-    // now instruct the radio to receive
-    // (lock interrupts only for final fine tuned rx timing...)
-    hal_disableIRQs();
+    // now instruct the radio to receive at exact rx time
     BACKTRACE();
-    // busy wait until exact rx time
     ostime_t rxtime = LMIC.rxtime - LORA_RXSTART_FIXUP;
     // SX127x bug fix: move exact RX time away from symbol boundary
     rxtime = bugfix_rxtime(rxtime);
-    // wait for it...
     ostime_t now = os_getTime();
-    hal_waitUntil(rxtime);
-    // enable antenna switch for RX (and account power consumption)
-    hal_ant_switch(HAL_ANTSW_RX);
-    // rx now...
-    writeReg(RegOpMode, OPMODE_LORA_RX_SINGLE);
-    // re-enable interrupts
-    hal_enableIRQs();
+    hal_timedCall(rxtime, rxlorastart);
     // warn about delayed rx
     if( rxtime - now < 0 ) {
         debug_printf("WARNING: rxtime is %ld ticks in the past! (ramp-up time %ld ms / %ld ticks)\r\n",
@@ -890,7 +907,15 @@ static void rxloracont (void) {
     writeReg(RegOpMode, OPMODE_LORA_RX);
 }
 
+// LoRa symbol time in osticks
+static ostime_t symticks (rps_t rps) {
+    return us2osticks(1 << (getSf(rps) - SF7 + 10 - getBw(rps)));
+}
+
 static void rxloracad (void) {
+    // continuous rx after preamble detection
+    state.cadrx = false;
+
     // select modem, setup TCXO, freq, modulation
     setuprxlora();
 
@@ -905,7 +930,7 @@ static void rxloracad (void) {
     writeReg(LORARegIrqFlagsMask, (uint8_t) ~(IRQ_LORA_CDDONE_MASK | IRQ_LORA_CDDETD_MASK | IRQ_LORA_RXDONE_MASK | IRQ_LORA_RXTOUT_MASK));
 
     // enable IRQs in HAL
-    hal_irqmask_set(HAL_IRQMASK_DIO0 | HAL_IRQMASK_DIO1 | HAL_IRQMASK_DIO3);
+    hal_irqmask_set(HAL_IRQMASK_DIO0 | HAL_IRQMASK_DIO1 | HAL_IRQMASK_DIO3 | HAL_IRQMASK_FAST); // switch to rx on detection
 
     // now instruct the radio to receive
     BACKTRACE();
@@ -915,6 +940,48 @@ static void rxloracad (void) {
     writeReg(RegOpMode, OPMODE_LORA_CAD);
 }
 
+// (called by HAL at exact rx time, interrupts disabled)
+static void rxloracadstart (void) {
+    // enable antenna switch for RX (and account power consumption)
+    hal_ant_switch(HAL_ANTSW_RX);
+    // start CAD...
+    writeReg(RegOpMode, OPMODE_LORA_CAD);
+}
+
+static void rxloracadwin (void) {
+    // select modem, setup TCXO, freq, modulation
+    setuprxlora();
+
+    // configure DIO mapping DIO0=RxDone DIO1=RxTout DIO2=NOP DIO3=CadDone DIO4=NOP DIO5=NOP
+    writeReg(RegDioMapping1, MAP1_LORA_DIO0_RXDONE | MAP1_LORA_DIO1_RXTOUT | MAP1_LORA_DIO2_NOP | MAP1_LORA_DIO3_CDDONE);
+    writeReg(RegDioMapping2, MAP2_LORA_DIO4_NOP | MAP2_LORA_DIO5_NOP);
+
+    // clear all radio IRQ flags
+    writeReg(LORARegIrqFlags, 0xFF);
+
+    // enable required radio IRQs
+    writeReg(LORARegIrqFlagsMask, (uint8_t) ~(IRQ_LORA_CDDONE_MASK | IRQ_LORA_CDDETD_MASK | IRQ_LORA_RXDONE_MASK | IRQ_LORA_RXTOUT_MASK));
+
+    // enable IRQs in HAL
+    hal_irqmask_set(HAL_IRQMASK_DIO0 | HAL_IRQMASK_DIO1 | HAL_IRQMASK_DIO3 | HAL_IRQMASK_FAST); // switch to rx on detection
+
+    // repeat CAD until last symbol of rx window, then switch to single rx on detection
+    state.cadrx = true;
+    state.cadend = LMIC.rxtime + (LMIC.rxsyms - 1) * symticks(LMIC.rps);
+
+    // now instruct the radio to start CAD at exact rx time
+    BACKTRACE();
+    hal_timedCall(LMIC.rxtime - LORA_RXSTART_FIXUP, rxloracadstart);
+}
+
+// (called by HAL at exact rx time, interrupts disabled)
+static void rxfskstart (void) {
+    // enable antenna switch for RX (and account power consumption)
+    hal_ant_switch(HAL_ANTSW_RX);
+    // rx
+    writeReg(RegOpMode, OPMODE_FSK_RX);
+}
+
 static void rxfsk (bool rxcontinuous) {
     // configure radio (needs rampup time)
     ostime_t t0 = os_getTime();
@@ -975,36 +1042,30 @@ static void rxfsk (bool rxcontinuous) {
     writeReg(RegDioMapping1, MAP1_FSK_DIO0_RXDONE | MAP1_FSK_DIO1_LEVEL | MAP1_FSK_DIO2_RXTOUT);
 
     // enable IRQs in HAL
-    hal_irqmask_set(HAL_IRQMASK_DIO0 | HAL_IRQMASK_DIO1 | HAL_IRQMASK_DIO2);
+    hal_irqmask_set(HAL_IRQMASK_DIO0 | HAL_IRQMASK_DIO1 | HAL_IRQMASK_DIO2 | HAL_IRQMASK_FAST); // FIFO drain
 
     // now instruct the radio to receive
-    hal_disableIRQs();
-
     if (rxcontinuous) {
         BACKTRACE();
+        hal_disableIRQs();
         // XXX not suppported - receiver does not automatically restart
         radio_set_irq_timeout(os_getTime() + sec2osticks(5)); // time out after 5 sec
+        rxfskstart();
+        hal_enableIRQs();
     } else {
         BACKTRACE();
         // set preamble timeout
         writeReg(FSKRegRxTimeout2, (LMIC.rxsyms + 1) / 2); // (TimeoutRxPreamble * 16 * Tbit)
         // set rx timeout
         radio_set_irq_timeout(LMIC.rxtime + us2osticks((u4_t)(2*FIFOTHRESH)*8*1000/50));
-        // busy wait until exact rx time
         ostime_t now = os_getTime();
         if (LMIC.rxtime - now < 0) {
             debug_printf("WARNING: rxtime is %ld ticks in the past! (ramp-up time %ld ms / %ld ticks)\r\n",
                          now - LMIC.rxtime, osticks2ms(now - t0), now - t0);
         }
-        hal_waitUntil(LMIC.rxtime);
+        // start at exact rx time
+        hal_timedCall(LMIC.rxtime, rxfskstart);
     }
-
-    // enable antenna switch for RX (and account power consumption)
-    hal_ant_switch(HAL_ANTSW_RX);
-
-    // rx
-    writeReg(RegOpMode, OPMODE_FSK_RX);
-    hal_enableIRQs();
 }
 
 void radio_startrx (bool rxcontinuous) {
@@ -1030,6 +1091,62 @@ void radio_cad (void) {
     rxloracad();
 }
 
+void radio_rxcad (void) {
+    if (isFsk(LMIC.rps)) { // no CAD for FSK - regular rx window
+        radio_startrx(false);
+        return;
+    }
+    ASSERT( (readReg(RegOpMode) & OPMODE_MASK) == OPMODE_SLEEP );
+
+    // set power consumption for statistics
+    LMIC.radioPwr_ua = 11500;
+
+    rxloracadwin();
+}
+
+// LMIC.rssi = CAD_RSSI_BUSY if LoRa preamble detected on freq=LMIC.freq, rps=LMIC.rps (else CAD_RSSI_CLEAR)
+void radio_ccacad (void) {
+    BACKTRACE();
+    ASSERT( (readReg(RegOpMode) & OPMODE_MASK) == OPMODE_SLEEP );
+
+    // select modem, setup TCXO, freq, modulation
+    setuprxlora();
+
+    // clear all radio IRQ flags, no HAL IRQs (polled)
+    writeReg(LORARegIrqFlags, 0xFF);
+    writeReg(LORARegIrqFlagsMask, (uint8_t) ~(IRQ_LORA_CDDONE_MASK | IRQ_LORA_CDDETD_MASK));
+
+    // set power consumption for statistics
+    LMIC.radioPwr_ua = 11500;
+
+    // enable antenna switch for RX (and account power consumption)
+    hal_ant_switch(HAL_ANTSW_RX);
+
+    // start CAD and wait for completion (takes about 2 symbols)
+    writeReg(RegOpMode, OPMODE_LORA_CAD);
+    ostime_t t0 = os_getTime();
+    ostime_t tout = 4 * symticks(LMIC.rps);
+    u1_t irqflags;
+    do {
+        irqflags = readReg(LORARegIrqFlags);
+    } while ((irqflags & IRQ_LORA_CDDONE_MASK) == 0 && os_getTime() - t0 < tout);
+
+    LMIC.rssi = (irqflags & IRQ_LORA_CDDETD_MASK) ? CAD_RSSI_BUSY : CAD_RSSI_CLEAR;
+
+    // mask and clear LoRa IRQ flags
+    writeReg(LORARegIrqFlagsMask, 0xFF);
+    writeReg(LORARegIrqFlags, 0xFF);
+
+    // shutdown receiver
+    radio_sleep();
+
+    // disable antenna switch
+    hal_ant_switch(HAL_ANTSW_OFF);
+
+    // power-down TCXO
+    hal_pin_tcxo(0);
+}
+
 void radio_starttx (bool txcontinuous) {
     ASSERT( (readReg(RegOpMode) & OPMODE_MASK) == OPMODE_SLEEP );
     if (isFsk(LMIC.rps)) { // FSK modem
@@ -1287,8 +1404,20 @@ bool radio_irq_process (ostime_t irqtime, u1_t diomask) {
             BACKTRACE();
             // check if preamble symbol was detected
             if (irqflags & IRQ_LORA_CDDETD_MASK) {
-                // switch to receiving (continuous)
-                writeReg(RegOpMode, OPMODE_LORA_RX);
+                if (state.cadrx) {
+                    // switch to receiving (single, ends with RxDone or RxTout)
+                    writeReg(LORARegIrqFlags, 0xFF);
+                    writeReg(RegOpMode, OPMODE_LORA_RX_SINGLE);
+                } else {
+                    // switch to receiving (continuous)
+                    writeReg(RegOpMode, OPMODE_LORA_RX);
+                }
+                // continue waiting
+                return false;
+            } else if (state.cadrx && irqtime - state.cadend < 0) {
+                // nothing detected yet - repeat CAD until end of rx window
+                writeReg(LORARegIrqFlags, 0xFF);
+                writeReg(RegOpMode, OPMODE_LORA_CAD);
                 // continue waiting
                 return false;
             } else {
@@ -1311,4 +1440,41 @@ bool radio_irq_process (ostime_t irqtime, u1_t diomask) {
     return true;
 }
 
+#if defined(BRD_multi_radio)
+// check for radio (reset and read version number)
+static bool sx127x_probe (void) {
+    hal_disableIRQs();
+    power_tcxo();
+    if (hal_pin_rst(RST_PIN_RESET_STATE)) {
+        hal_waitUntil(os_getTime() + ms2osticks(1));
+        hal_pin_rst(2);
+        hal_waitUntil(os_getTime() + ms2osticks(10));
+    }
+    bool found = (readReg(RegVersion) == RADIO_VERSION);
+    hal_pin_tcxo(0);
+    hal_enableIRQs();
+    return found;
+}
+
+static ostime_t sx127x_rxrampup (void) {
+    return us2osticksCeil(2800);
+}
+
+const radio_ops_t radio_ops_sx127x = {
+    .probe = sx127x_probe,
+    .init = radio_init,
+    .irq_process = radio_irq_process,
+    .starttx = radio_starttx,
+    .startrx = radio_startrx,
+    .sleep = radio_sleep,
+    .cca = radio_cca,
+    .cad = radio_cad,
+    .rxcad = radio_rxcad,
+    .ccacad = radio_ccacad,
+    .cw = radio_cw,
+    .generate_random = NULL,
+    .rxrampup = sx127x_rxrampup,
+};
+#endif // defined(BRD_multi_radio)
+
 #endif
@@ -10,6 +10,85 @@
 #include "board.h"
 #include "lmic.h"
 
+#if defined(BRD_multi_radio)
+#if !(defined(BRD_sx1272_radio) || defined(BRD_sx1276_radio)) || !(defined(BRD_sx1261_radio) || defined(BRD_sx1262_radio))
+#error "BRD_multi_radio requires one SX127x and one SX126x radio"
+#endif
+
+// ----------------------------------------
+// RUNTIME DRIVER SELECTION
+
+// radio drivers in probing order
+// (SX127x first, it does not depend on the BUSY line)
+static const radio_ops_t* const radio_drivers[] = {
+    &radio_ops_sx127x,
+    &radio_ops_sx126x,
+};
+
+// driver of detected radio
+static const radio_ops_t* radio_ops;
+
+void radio_init (bool calibrate) {
+    if (radio_ops == NULL) {
+        for (size_t i = 0; i < sizeof(radio_drivers) / sizeof(radio_drivers[0]); i++) {
+            if (radio_drivers[i]->probe()) {
+                radio_ops = radio_drivers[i];
+                break;
+            }
+        }
+        ASSERT(radio_ops != NULL);
+    }
+    radio_ops->init(calibrate);
+}
+
+bool radio_irq_process (ostime_t irqtime, u1_t diomask) {
+    return radio_ops->irq_process(irqtime, diomask);
+}
+
+void radio_starttx (bool txcontinuous) {
+    radio_ops->starttx(txcontinuous);
+}
+
+void radio_startrx (bool rxcontinuous) {
+    radio_ops->startrx(rxcontinuous);
+}
+
+void radio_sleep (void) {
+    radio_ops->sleep();
+}
+
+void radio_cca (void) {
+    radio_ops->cca();
+}
+
+void radio_cad (void) {
+    radio_ops->cad();
+}
+
+void radio_rxcad (void) {
+    radio_ops->rxcad();
+}
+
+void radio_ccacad (void) {
+    radio_ops->ccacad();
+}
+
+void radio_cw (void) {
+    radio_ops->cw();
+}
+
+void radio_generate_random (u4_t *words, u1_t len) {
+    // (keep words unchanged if not supported by radio)
+    if (radio_ops->generate_random) {
+        radio_ops->generate_random(words, len);
+    }
+}
+
+ostime_t radio_rxrampup (void) {
+    return radio_ops->rxrampup();
+}
+#endif // defined(BRD_multi_radio)
+
 // ----------------------------------------
 // RADIO STATE
 static struct {
@@ -33,6 +112,8 @@ static void radio_stop (void) {
     // disable antenna switch
     // disable IRQs in HAL
     hal_irqmask_set(0);
+    // cancel timed radio start
+    hal_timedCall(0, NULL);
     // cancel radio job
     os_clearCallback(&state.irqjob);
     // clear state
@@ -197,6 +278,21 @@ void os_radio (u1_t mode) {
             radio_starttx(true);
             break;
 
+        case RADIO_RXCAD:
+            radio_stop();
+            // receive frame at rxtime, keep receiver on only if CAD detects a preamble (wait for completion interrupt)
+            radio_rxcad();
+            // set timeout for rx operation (should not happen, might be updated by radio driver)
+            state.txmode = 0;
+            radio_set_irq_timeout(LMIC.rxtime + ms2osticks(5) + LMIC_calcAirTime(LMIC.rps, 255) * 110 / 100);
+            break;
+
+        case RADIO_CCACAD:
+            radio_stop();
+            // clear channel assessment using CAD
+            radio_ccacad();
+            break;
+
         case RADIO_CAD:
             radio_stop();
             // set timeout for cad/rx operation (should not happen, might be updated by radio driver)
@@ -0,0 +1,13 @@
+// Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+//
+// This file is subject to the terms and conditions defined in file 'LICENSE',
+// which is part of this source code package.
+
+// Host board for lmic unit tests (no hardware is accessed)
+
+#ifndef _board_h_
+#define _board_h_
+
+#define BRD_sx1276_radio
+
+#endif
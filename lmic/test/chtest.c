@@ -0,0 +1,179 @@
+// Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+//
+// This file is subject to the terms and conditions defined in file 'LICENSE',
+// which is part of this source code package.
+
+// Fixed channel plan test driver and channel selection benchmark
+//
+// Runs the fixed-plan hopping engine on the host and prints the channels it
+// picks for a few channel masks; chtest.py checks them against the region
+// definitions in tools/pylora/loradefs.py. With -b, measures the cost of a
+// channel selection instead.
+
+#include "../lmic.c"    // test static channel functions directly
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+// ------------------------------------------------
+// HAL and OS stubs
+
+static osxtime_t XNOW = 1000000;
+
+osxtime_t os_getXTime (void) { return XNOW; }
+ostime_t os_getTime (void) { return (ostime_t) XNOW; }
+osxtime_t os_time2XTime (ostime_t t, osxtime_t ctx) { return ctx + (ostime_t) (t - (ostime_t) ctx); }
+u1_t os_getRndU1 (void) { return rand(); }
+void os_radio (u1_t mode) { }
+void os_setTimedCallbackEx (osjob_t* job, ostime_t time, osjobcb_t cb, unsigned int flags) { }
+int os_clearCallback (osjob_t* job) { return 0; }
+u1_t os_getBattLevel (void) { return 0; }
+u1_t os_getRegion (void) { return 0; }
+void os_getDevEui (u1_t* buf) { memset(buf, 0x11, 8); }
+void os_getJoinEui (u1_t* buf) { memset(buf, 0x22, 8); }
+u4_t hal_dnonce_next (void) { return 1; }
+void hal_enableIRQs (void) { }
+void onLmicEvent (ev_t ev) { }
+
+void hal_failed (void) {
+    fprintf(stderr, "hal_failed\n");
+    abort();
+}
+
+void lce_encKey0 (u1_t* buf) {
+    for (int i = 0; i < 16; i++) {
+        buf[i] = buf[i] * 31 + 7 + i;
+    }
+}
+void lce_cipher (s1_t keyid, u4_t devaddr, u4_t seqno, int cat, u1_t* payload, int len) { }
+void lce_addMic (s1_t keyid, u4_t devaddr, u4_t seqno, u1_t* pdu, int len) { }
+bool lce_verifyMic (s1_t keyid, u4_t devaddr, u4_t seqno, u1_t* pdu, int len) { return 1; }
+void lce_addMicJoinReq (u1_t* pdu, int len) { }
+bool lce_processJoinAccept (u1_t* jacc, u1_t jacclen, u2_t devnonce) { return 1; }
+void lce_loadSessionKeys (const u1_t* nwkSKey, const u1_t* appSKey) { }
+
+
+// ------------------------------------------------
+// Testing
+
+static const struct {
+    const char* name;
+    u1_t regcode;
+} regions[] = {
+#ifdef CFG_us915
+    { "US915", REGCODE_US915 },
+#endif
+#ifdef CFG_au915
+    { "AU915", REGCODE_AU915 },
+#endif
+#ifdef CFG_cn470
+    { "CN470", REGCODE_CN470 },
+#endif
+};
+
+static void hop (void) {
+    LMIC.opmode |= OP_NEXTCHNL;
+    LMIC_nextTx(os_getTime());
+}
+
+// print enabled channels followed by n hops at data rate dr
+static void hops (int n, dr_t dr) {
+    printf("M");
+    for (int i = 0; i < numChannels(); i++) {
+        if (LMIC.fix.channelMap[i >> 4] & (1 << (i & 15))) {
+            printf(" %d", i);
+        }
+    }
+    printf("\n");
+    LMIC.datarate = dr;
+    for (int i = 0; i < n; i++) {
+        hop();
+        printf("H %d %d %u\n", dr, LMIC.txChnl, chnlFreq_fix(LMIC.txChnl));
+    }
+}
+
+static void run (void) {
+    int nch = REGION.numChBlocks * 8;
+    printf("R %d %d %d\n", numChannels(), REGION.maxEirp, REGION.fixDr);
+
+    // all channels on
+    hops(2 * nch, 0);
+    if (REGION.baseFreqFix) {
+        hops(2 * REGION.numChBlocks, REGION.fixDr);
+    }
+
+    // second sub-band only
+    for (int i = 0; i < numChannels(); i++) {
+        if (!((i >= 8 && i < 16) || i == nch + 1)) {
+            LMIC_disableChannel(i);
+        }
+    }
+    hops(16, 0);
+    if (REGION.baseFreqFix) {
+        hops(2, REGION.fixDr);
+    }
+    LMIC_disableChannel(10);
+    hops(14, 0);
+
+    // sparse plan, changed while hopping
+    enableAllChannels_fix();
+    for (int i = 0; i < nch; i += 3) {
+        LMIC_disableChannel(i);
+    }
+    hops(nch, 0);
+    LMIC_disableChannel(1);
+    LMIC_disableChannel(nch - 1);
+    hops(nch, 0);
+}
+
+static double now (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+static void bench (const char* name) {
+    int nch = REGION.numChBlocks * 8;
+    int n = 1000000;
+    for (int enabled = 8; ; enabled = nch) {
+        enableAllChannels_fix();
+        for (int i = enabled; i < numChannels(); i++) {
+            LMIC_disableChannel(i);
+        }
+        LMIC.datarate = 0;
+        hop();  // rebuild hoplist
+        double t = now();
+        for (int i = 0; i < n; i++) {
+            hop();
+        }
+        t = now() - t;
+        printf("%-8s %3d/%-3d channels %8.1f ns/hop\n", name, enabled, nch, t / n * 1e9);
+        if (enabled == nch) {
+            break;
+        }
+    }
+}
+
+int main (int argc, char** argv) {
+    int b = (argc > 1 && strcmp(argv[1], "-b") == 0);
+    if (argc != 2 + b) {
+        printf("usage: %s [-b] <REGION>\n", argv[0]);
+        return 1;
+    }
+    for (int i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        if (strcmp(argv[1 + b], regions[i].name) == 0) {
+            LMIC_reset_ex(regions[i].regcode);
+            LMIC_setSession(1, 0x1234, NULL, NULL);
+            if (b) {
+                bench(regions[i].name);
+            } else {
+                run();
+            }
+            return 0;
+        }
+    }
+    printf("unknown region: %s\n", argv[1 + b]);
+    return 1;
+}
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+
+# Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+#
+# This file is subject to the terms and conditions defined in file 'LICENSE',
+# which is part of this source code package.
+
+# Check channel selection of the lmic fixed-plan engine (chtest) against the
+# region definitions in loradefs.
+
+from typing import List,Set
+
+import argparse
+import subprocess
+import sys
+
+import loradefs as ld
+
+def check(name:str, exe:str) -> None:
+    reg = getattr(ld, 'Region_' + name)()
+    out = subprocess.run([exe, name], check=True, stdout=subprocess.PIPE,
+            universal_newlines=True).stdout.splitlines()
+
+    nch, maxeirp, fixdr = map(int, out[0].split()[1:])
+    assert nch == len(reg.upchannels), f'{name}: {nch} channels, loradefs has {len(reg.upchannels)}'
+    assert maxeirp == int(reg.max_eirp), f'{name}: max EIRP {maxeirp}, loradefs has {reg.max_eirp}'
+
+    enabled = set()     # type: Set[int]
+    seq = []            # type: List[int]
+    def check_cycles() -> None:
+        # every enabled channel of the DR is used once per cycle
+        if not seq:
+            return
+        usable = sorted(ch for ch in enabled if reg.upchannels[ch].minDR <= dr <= reg.upchannels[ch].maxDR)
+        n = len(usable)
+        for i in range(0, len(seq) - n + 1, n):
+            assert sorted(seq[i:i+n]) == usable, f'{name}: DR{dr} cycle {seq[i:i+n]} does not cover {usable}'
+
+    dr = 0
+    for line in out[1:]:
+        f = line.split()
+        if f[0] == 'M':
+            check_cycles()
+            enabled = set(map(int, f[1:]))
+            seq = []
+        elif f[0] == 'H':
+            dr, ch, freq = map(int, f[1:])
+            assert ch in enabled, f'{name}: disabled channel {ch} used'
+            chdef = reg.upchannels[ch]
+            assert freq == chdef.freq, f'{name}: channel {ch} at {freq}, loradefs has {chdef.freq}'
+            assert chdef.minDR <= dr <= chdef.maxDR, f'{name}: DR{dr} not allowed on channel {ch}'
+            reg.check_freq(freq)
+            seq.append(ch)
+    check_cycles()
+    print(f'{name}: ok')
+
+if __name__ == '__main__':
+    p = argparse.ArgumentParser()
+    p.add_argument('exe', help='chtest executable')
+    p.add_argument('regions', nargs='+', help='regions to check')
+    args = p.parse_args()
+    for r in args.regions:
+        check(r, args.exe)
@@ -0,0 +1,17 @@
+// Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+//
+// This file is subject to the terms and conditions defined in file 'LICENSE',
+// which is part of this source code package.
+
+// COMPILE-ONLY configuration of a hybrid radio build (BRD_multi_radio).
+// This is not a board: there are no pins and nothing is run, it only makes
+// sure both drivers and the runtime driver selection build and link together.
+
+#ifndef _board_h_
+#define _board_h_
+
+#define BRD_multi_radio
+#define BRD_sx1276_radio
+#define BRD_sx1262_radio
+
+#endif
@@ -0,0 +1,11 @@
+// Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+//
+// This file is subject to the terms and conditions defined in file 'LICENSE',
+// which is part of this source code package.
+
+// COMPILE-ONLY configuration (see board.h) - no HAL peripherals
+
+#ifndef _hw_h_
+#define _hw_h_
+
+#endif
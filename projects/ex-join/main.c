@@ -18,6 +18,7 @@ static void txc (void) {
 static bool tx (lwm_txinfo* txinfo) {
     txinfo->data = (unsigned char*) "hello";
     txinfo->dlen = 5;
+    txinfo->nocopy = true;
     txinfo->port = 15;
     txinfo->txcomplete = txc;
     return true;
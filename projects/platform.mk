@@ -82,6 +82,7 @@ ifneq (ok,$(shell python3 -c 'import sys; print("ok" if sys.hexversion >= 0x0306
 endif
 
 SVCTOOL = $(TOOLSDIR)/svctool/svctool.py
+RAMSIZE = $(TOOLSDIR)/ramsize/ramsize.py
 
 FWTOOL = $(BL)/tools/fwtool/fwtool.py
 ZFWTOOL = $(BL)/tools/fwtool/zfwtool.py
@@ -96,6 +97,7 @@ ifeq ($(TOOLCHAIN),gcc)
     CC		:= $(CROSS_COMPILE)gcc
     AS		:= $(CROSS_COMPILE)as
     LD		:= $(CROSS_COMPILE)gcc
+    OBJDUMP	:= $(CROSS_COMPILE)objdump
     HEX		:= $(CROSS_COMPILE)objcopy -O ihex
     BIN		:= $(CROSS_COMPILE)objcopy -O binary
     GDB		:= $(CROSS_COMPILE)gdb
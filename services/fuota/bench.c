@@ -0,0 +1,43 @@
+// Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+//
+// This file is subject to the terms and conditions defined in file 'LICENSE',
+// which is part of this source code package.
+
+// Fragmentation carousel encoder benchmark
+
+#include "fragenc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+int main (int argc, char** argv) {
+    int nthreads = (argc > 1) ? atoi(argv[1]) : 0;
+    uint32_t chunk_nw = 60; // 60 words = 240 bytes
+
+    printf("%10s %8s %12s %12s\n", "image", "chunks", "frags/s", "MB/s");
+    for (uint32_t isz = 16 * 1024; isz <= 4 * 1024 * 1024; isz <<= 2) {
+        uint32_t chunk_ct = (isz + (chunk_nw << 2) - 1) / (chunk_nw << 2);
+        uint32_t* src = malloc(chunk_ct * chunk_nw * 4);
+        for (uint32_t i = 0; i < chunk_ct * chunk_nw; i++) {
+            src[i] = rand();
+        }
+        // generate one carousel's worth of redundancy, but at least 2000 fragments
+        uint32_t n = (chunk_ct < 2000) ? 2000 : chunk_ct;
+        uint32_t* dst = malloc(n * chunk_nw * 4);
+        double t = now();
+        fragenc_gen(dst, src, chunk_ct, chunk_nw, 0x1000, 0x1000 + n, nthreads);
+        t = now() - t;
+        printf("%10u %8u %12.0f %12.1f\n", isz, chunk_ct, n / t,
+                (n * (chunk_nw << 2)) / t / 1e6);
+        free(dst);
+        free(src);
+    }
+    return 0;
+}
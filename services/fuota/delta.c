@@ -0,0 +1,170 @@
+// Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+//
+// This file is subject to the terms and conditions defined in file 'LICENSE',
+// which is part of this source code package.
+
+#include <string.h>
+
+#include "fuota_hal.h"
+#include "delta.h"
+
+typedef struct {
+    const uint8_t* ptr;         // current position in op stream
+    const uint8_t* end;         // end of op stream
+} rd_state;
+
+typedef struct {
+    uint8_t* dst;               // start of output
+    uint32_t* base;             // next page to write
+    uint32_t off;               // bytes in page buffer
+    uint32_t total;             // total bytes written
+    uint32_t max;               // max bytes to write
+    uint32_t buf[fuota_flash_pagesz >> 2];
+} wr_state;
+
+static wr_state wr; // page buffer
+
+static bool rd_varint (rd_state* rd, uint32_t* pval) {
+    uint32_t val = 0;
+    for( int shift = 0; shift < 32; shift += 7 ) {
+        if( rd->ptr == rd->end ) {
+            return false;
+        }
+        uint8_t b = *rd->ptr++;
+        val |= ((uint32_t) (b & 0x7f)) << shift;
+        if( (b & 0x80) == 0 ) {
+            *pval = val;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void wr_flush (wr_state* wr) {
+    if( wr->off ) {
+        memset((uint8_t*) wr->buf + wr->off, 0, sizeof(wr->buf) - wr->off);
+        fuota_flash_write(wr->base, wr->buf, sizeof(wr->buf) >> 2, true);
+        wr->base += sizeof(wr->buf) >> 2;
+        wr->off = 0;
+    }
+}
+
+static bool wr_bytes (wr_state* wr, const uint8_t* src, uint32_t len) {
+    if( len > wr->max - wr->total ) {
+        return false;
+    }
+    wr->total += len;
+    while( len ) {
+        uint32_t n = sizeof(wr->buf) - wr->off;
+        if( n > len ) {
+            n = len;
+        }
+        memcpy((uint8_t*) wr->buf + wr->off, src, n);
+        wr->off += n;
+        src += n;
+        len -= n;
+        if( wr->off == sizeof(wr->buf) ) {
+            wr_flush(wr);
+        }
+    }
+    return true;
+}
+
+// read byte from output -- either from page buffer or from flash (little endian)
+static uint8_t wr_peek (wr_state* wr, uint32_t pos) {
+    uint32_t bpos = (uint8_t*) wr->base - wr->dst;
+    if( pos >= bpos ) {
+        return ((uint8_t*) wr->buf)[pos - bpos];
+    } else {
+        return fuota_flash_rd_u4(wr->dst + (pos & ~3)) >> ((pos & 3) << 3);
+    }
+}
+
+static void wr_init (void* dst, uint32_t max) {
+    wr.dst = dst;
+    wr.base = dst;
+    wr.off = 0;
+    wr.total = 0;
+    wr.max = max;
+}
+
+int delta_apply (const delta_hdr* delta, const void* src, void* dst) {
+    if( delta->size < sizeof(delta_hdr) ) {
+        return -1;
+    }
+    rd_state rd = {
+        .ptr = (const uint8_t*) (delta + 1),
+        .end = (const uint8_t*) delta + delta->size,
+    };
+    wr_init(dst, delta->dstsize);
+
+    uint32_t spos = 0;
+    while( wr.total < wr.max ) {
+        uint32_t op, len;
+        if( !rd_varint(&rd, &op) ) {
+            return -1;
+        }
+        len = op >> 1;
+        if( op & 1 ) {
+            // literal
+            if( len > rd.end - rd.ptr || !wr_bytes(&wr, rd.ptr, len) ) {
+                return -1;
+            }
+            rd.ptr += len;
+        } else {
+            // copy from running firmware
+            uint32_t zz;
+            if( !rd_varint(&rd, &zz) ) {
+                return -1;
+            }
+            spos += (zz >> 1) ^ -(zz & 1);
+            if( spos > delta->srcsize || len > delta->srcsize - spos
+                    || !wr_bytes(&wr, (const uint8_t*) src + spos, len) ) {
+                return -1;
+            }
+            spos += len;
+        }
+    }
+    wr_flush(&wr);
+    return wr.total;
+}
+
+int lz_apply (const lz_hdr* lz, void* dst) {
+    if( lz->size < sizeof(lz_hdr) ) {
+        return -1;
+    }
+    rd_state rd = {
+        .ptr = (const uint8_t*) (lz + 1),
+        .end = (const uint8_t*) lz + lz->size,
+    };
+    wr_init(dst, lz->dstsize);
+
+    while( wr.total < wr.max ) {
+        uint32_t op, len;
+        if( !rd_varint(&rd, &op) ) {
+            return -1;
+        }
+        len = op >> 1;
+        if( op & 1 ) {
+            // literal
+            if( len > rd.end - rd.ptr || !wr_bytes(&wr, rd.ptr, len) ) {
+                return -1;
+            }
+            rd.ptr += len;
+        } else {
+            // copy from output (may overlap)
+            uint32_t dist;
+            if( !rd_varint(&rd, &dist) || dist == 0 || dist > wr.total ) {
+                return -1;
+            }
+            while( len-- ) {
+                uint8_t b = wr_peek(&wr, wr.total - dist);
+                if( !wr_bytes(&wr, &b, 1) ) {
+                    return -1;
+                }
+            }
+        }
+    }
+    wr_flush(&wr);
+    return wr.total;
+}
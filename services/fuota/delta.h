@@ -0,0 +1,66 @@
+// Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+//
+// This file is subject to the terms and conditions defined in file 'LICENSE',
+// which is part of this source code package.
+
+#ifndef _delta_h_
+#define _delta_h_
+
+#include <stdint.h>
+
+// Delta update container (all fields little endian):
+//
+//   delta_hdr | op stream | padding | signatures
+//
+// The op stream reconstructs a regular update (boot_uphdr and payload) from
+// the running firmware image. Each op starts with a varint:
+//   (len << 1) | 0, zigzag varint offset -- copy len bytes from the running
+//                                           firmware; the offset is relative
+//                                           to the end of the previous copy
+//   (len << 1) | 1, bytes[len]           -- insert len literal bytes
+// The signatures are over the reconstructed update.
+
+#define DELTA_MAGIC     0x544c4544  // "DELT"
+
+typedef struct {
+    uint32_t magic;     // DELTA_MAGIC
+    uint32_t size;      // size of header and op stream (padded to multiple of 4)
+    uint32_t srccrc;    // CRC of firmware the delta applies to (hal_fwinfo)
+    uint32_t srcsize;   // size of firmware the delta applies to
+    uint32_t dstsize;   // size of reconstructed update
+} delta_hdr;
+
+// Compressed update container (all fields little endian):
+//
+//   lz_hdr | op stream | padding | signatures
+//
+// The op stream is LZ77-compressed update data. It uses the same varints as
+// the delta op stream, but copies refer to the data already reconstructed:
+//   (len << 1) | 0, varint distance      -- copy len bytes starting distance
+//                                           bytes back in the output
+//   (len << 1) | 1, bytes[len]           -- insert len literal bytes
+// The already written output in flash serves as the window, so decompression
+// only needs a single page buffer in RAM.
+
+#define LZ_MAGIC        0x504d434c  // "LCMP"
+
+typedef struct {
+    uint32_t magic;     // LZ_MAGIC
+    uint32_t size;      // size of header and op stream (padded to multiple of 4)
+    uint32_t dstsize;   // size of reconstructed update
+} lz_hdr;
+
+// reconstruct update into flash
+// - delta:     pointer to delta container
+// - src:       pointer to running firmware
+// - dst:       page-aligned pointer to flash area (must hold dstsize rounded up to page size)
+// returns the size of the reconstructed update, or -1 on error
+int delta_apply (const delta_hdr* delta, const void* src, void* dst);
+
+// decompress update into flash
+// - lz:        pointer to compressed update container
+// - dst:       page-aligned pointer to flash area (must hold dstsize rounded up to page size)
+// returns the size of the reconstructed update, or -1 on error
+int lz_apply (const lz_hdr* lz, void* dst);
+
+#endif
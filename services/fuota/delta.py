@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+
+# Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+#
+# This file is subject to the terms and conditions defined in file 'LICENSE',
+# which is part of this source code package.
+
+# Delta and compressed update generator (see delta.h for the container formats)
+
+from typing import Dict,List,Tuple
+
+import argparse
+import random
+import struct
+import sys
+
+DELTA_MAGIC = 0x544c4544
+HDR_FMT     = '<IIIII'
+HDR_SZ      = struct.calcsize(HDR_FMT)
+
+LZ_MAGIC    = 0x504d434c
+LZ_HDR_FMT  = '<III'
+LZ_HDR_SZ   = struct.calcsize(LZ_HDR_FMT)
+
+def varint(v:int) -> bytes:
+    b = bytearray()
+    while True:
+        if v < 0x80:
+            b.append(v)
+            return bytes(b)
+        b.append((v & 0x7f) | 0x80)
+        v >>= 7
+
+def zigzag(v:int) -> int:
+    return (v << 1) if v >= 0 else (((-v) << 1) - 1)
+
+class Delta:
+    KEYLEN   = 8    # length of indexed source substrings
+    MINMATCH = 12   # minimum copy length
+    MAXCAND  = 32   # max. candidate positions per substring
+
+    @staticmethod
+    def ops(src:bytes, dst:bytes) -> bytes:
+        kl = Delta.KEYLEN
+        index:Dict[bytes,List[int]] = {}
+        for i in range(len(src) - kl + 1):
+            c = index.setdefault(src[i:i+kl], [])
+            if len(c) < Delta.MAXCAND:
+                c.append(i)
+
+        out = bytearray()
+        spos = 0    # end of previous copy
+        lit = bytearray()
+        i = 0
+        while i < len(dst):
+            best_len, best_off = 0, 0
+            for off in index.get(dst[i:i+kl], ()):
+                n = kl
+                while i + n < len(dst) and off + n < len(src) and dst[i+n] == src[off+n]:
+                    n += 1
+                # prefer longer matches, then offsets close to the expected position
+                if n > best_len or (n == best_len and abs(off - spos) < abs(best_off - spos)):
+                    best_len, best_off = n, off
+            if best_len >= Delta.MINMATCH:
+                if lit:
+                    out += varint((len(lit) << 1) | 1) + lit
+                    lit = bytearray()
+                out += varint(best_len << 1) + varint(zigzag(best_off - spos))
+                spos = best_off + best_len
+                i += best_len
+            else:
+                lit.append(dst[i])
+                i += 1
+        if lit:
+            out += varint((len(lit) << 1) | 1) + lit
+        return bytes(out)
+
+    @staticmethod
+    def create(fw:bytes, update:bytes) -> bytes:
+        """Create delta container from running firmware and signed update."""
+        srccrc, srcsize = struct.unpack_from('<II', fw)
+        upsize, = struct.unpack_from('<I', update, 4)
+        ops = Delta.ops(fw[:srcsize], update[:upsize])
+        size = HDR_SZ + len(ops)
+        ops += bytes(-size & 3)
+        size += -size & 3
+        return struct.pack(HDR_FMT, DELTA_MAGIC, size, srccrc, srcsize, upsize) + ops + update[upsize:]
+
+    @staticmethod
+    def apply(fw:bytes, delta:bytes) -> bytes:
+        """Reconstruct signed update (reference implementation of delta.c)."""
+        magic, size, srccrc, srcsize, dstsize = struct.unpack_from(HDR_FMT, delta)
+        if magic != DELTA_MAGIC or struct.unpack_from('<II', fw) != (srccrc, srcsize):
+            raise ValueError('delta does not apply to firmware')
+        out = bytearray()
+        p, spos = HDR_SZ, 0
+        while len(out) < dstsize:
+            op, p = rd_varint(delta, p)
+            n = op >> 1
+            if op & 1:
+                out += delta[p:p+n]
+                p += n
+            else:
+                zz, p = rd_varint(delta, p)
+                spos += (zz >> 1) ^ -(zz & 1)
+                out += fw[spos:spos+n]
+                spos += n
+        if len(out) != dstsize:
+            raise ValueError('invalid delta')
+        return bytes(out) + delta[size:]
+
+def rd_varint(buf:bytes, p:int) -> Tuple[int,int]:
+    v = s = 0
+    while True:
+        b = buf[p]
+        v |= (b & 0x7f) << s
+        p += 1
+        s += 7
+        if not b & 0x80:
+            return v, p
+
+class Compressed:
+    MINMATCH = 4        # minimum match length
+    MAXCAND  = 64       # max. candidate positions searched per match
+    WINDOW   = 64*1024  # max. match distance
+
+    @staticmethod
+    def ops(data:bytes) -> bytes:
+        ml = Compressed.MINMATCH
+        index:Dict[bytes,List[int]] = {}
+        out = bytearray()
+        lit = bytearray()
+        i = 0
+        def add(p:int) -> None:
+            index.setdefault(data[p:p+ml], []).append(p)
+        while i < len(data):
+            best_len, best_dist = 0, 0
+            for p in reversed(index.get(data[i:i+ml], [])[-Compressed.MAXCAND:]):
+                if i - p > Compressed.WINDOW:
+                    break
+                n = 0
+                while i + n < len(data) and data[p+n] == data[i+n]:
+                    n += 1
+                if n > best_len:
+                    best_len, best_dist = n, i - p
+            if best_len >= ml:
+                if lit:
+                    out += varint((len(lit) << 1) | 1) + lit
+                    lit = bytearray()
+                out += varint(best_len << 1) + varint(best_dist)
+                for p in range(i, i + best_len):
+                    add(p)
+                i += best_len
+            else:
+                lit.append(data[i])
+                add(i)
+                i += 1
+        if lit:
+            out += varint((len(lit) << 1) | 1) + lit
+        return bytes(out)
+
+    @staticmethod
+    def create(update:bytes) -> bytes:
+        """Create compressed container from signed update."""
+        upsize, = struct.unpack_from('<I', update, 4)
+        ops = Compressed.ops(update[:upsize])
+        size = LZ_HDR_SZ + len(ops)
+        ops += bytes(-size & 3)
+        size += -size & 3
+        return struct.pack(LZ_HDR_FMT, LZ_MAGIC, size, upsize) + ops + update[upsize:]
+
+    @staticmethod
+    def apply(lz:bytes) -> bytes:
+        """Decompress signed update (reference implementation of delta.c)."""
+        magic, size, dstsize = struct.unpack_from(LZ_HDR_FMT, lz)
+        if magic != LZ_MAGIC:
+            raise ValueError('not a compressed update')
+        out = bytearray()
+        p = LZ_HDR_SZ
+        while len(out) < dstsize:
+            op, p = rd_varint(lz, p)
+            n = op >> 1
+            if op & 1:
+                out += lz[p:p+n]
+                p += n
+            else:
+                dist, p = rd_varint(lz, p)
+                for _ in range(n):
+                    out.append(out[-dist])
+        if len(out) != dstsize:
+            raise ValueError('invalid compressed update')
+        return bytes(out) + lz[size:]
+
+if __name__ == '__main__':
+    p = argparse.ArgumentParser(description='Create delta or compressed update')
+    p.add_argument('-z', '--compress', action='store_true', help='create compressed update (no firmware argument)')
+    p.add_argument('fw', nargs='?', help='running firmware image (as flashed)')
+    p.add_argument('update', nargs='?', help='signed update for new firmware')
+    p.add_argument('out', nargs='?', help='output delta update')
+    args = p.parse_args()
+
+    if args.compress:
+        with open(args.fw, 'rb') as f:
+            up = f.read()
+        d = Compressed.create(up)
+        assert Compressed.apply(d) == up
+        with open(args.update, 'wb') as f:
+            f.write(d)
+        print('%s: %d bytes (update %d bytes, %.1f%%)' % (args.update, len(d), len(up), 100 * len(d) / len(up)))
+    elif args.fw:
+        with open(args.fw, 'rb') as f:
+            fw = f.read()
+        with open(args.update, 'rb') as f:
+            up = f.read()
+        d = Delta.create(fw, up)
+        assert Delta.apply(fw, d) == up
+        with open(args.out, 'wb') as f:
+            f.write(d)
+        print('%s: %d bytes (update %d bytes, %.1f%%)' % (args.out, len(d), len(up), 100 * len(d) / len(up)))
+    else:
+        # self-test with a simulated patch release
+        fw = bytearray(random.randrange(256) for _ in range(60*1024))
+        fw[0:8] = struct.pack('<II', 0x12345678, len(fw))
+        new = bytearray(fw)
+        for _ in range(20):     # scattered small changes
+            o = random.randrange(len(new) - 4)
+            new[o:o+4] = bytes(random.randrange(256) for _ in range(4))
+        o = random.randrange(len(new))
+        new[o:o] = bytes(random.randrange(256) for _ in range(256)) # inserted code
+        up = struct.pack('<II', 0, len(new) + 8) + new + bytes(64)  # fake header and signature
+        d = Delta.create(bytes(fw), up)
+        assert Delta.apply(bytes(fw), d) == up
+        print('update %d bytes, delta %d bytes (%.1f%%)' % (len(up), len(d), 100 * len(d) / len(up)))
@@ -92,6 +92,10 @@ static struct {
 
     lwm_job lwmjob;             // uplink job
 
+    osjob_t stjob;              // delayed status answer job
+    ostime_t sttime;            // time of delayed status answer
+    uint8_t stpend;             // sessions with delayed status answer pending
+
     struct {
         void* beg;              // beginning of storage area
         void* end;              // end of storage area
@@ -124,6 +128,13 @@ static fuota_session* get_session (int idx) {
             - fuota_flash_pagesz);
 }
 
+static bool session_complete (int idx) {
+    int st;
+    return idx < SESSION_MAX && state.ps.sessions[idx].abeg != NULL
+        && ((st = fuota_state(get_session(idx), NULL, NULL, NULL, NULL)) == FUOTA_COMPLETE
+                || st == FUOTA_UNPACKED);
+}
+
 #define ROUND_PAGE_SZ(sz) \
     (((sz) + (fuota_flash_pagesz - 1)) & ~(fuota_flash_pagesz - 1))
 static int calc_session_size (uint32_t cct, uint32_t cnw, int* pmsz, int* pdsz) {
@@ -160,6 +171,9 @@ void _frag_restore (void) {
                     // TODO - should check all saved parameters
                     debug_printf("frag: recovered session 0x%08x\r\n",
                             state.ps.sessions[i].desc);
+                    if( session_complete(i) ) {
+                        SVCHOOK_frag_complete(i);
+                    }
                 } else {
                     goto invalid;
                 }
@@ -198,6 +212,32 @@ int frag_get (int idx, void** pdata) {
     }
 }
 
+// store digest of unpacked session data (e.g. hash computed in background)
+void frag_set_digest (int idx, const uint32_t* digest) {
+    if( idx < SESSION_MAX && state.ps.sessions[idx].abeg != NULL ) {
+        fuota_set_digest(get_session(idx), digest);
+    }
+}
+
+bool frag_get_digest (int idx, uint32_t* digest) {
+    return idx < SESSION_MAX && state.ps.sessions[idx].abeg != NULL
+        && fuota_get_digest(get_session(idx), digest);
+}
+
+// get unused, page-aligned part of session storage in front of the
+// session allocation (e.g. to reconstruct a delta update)
+int frag_get_spare (int idx, void** pbeg) {
+    if( idx < SESSION_MAX && state.storage[idx].beg != NULL ) {
+        void* end = state.ps.sessions[idx].abeg ?
+            state.ps.sessions[idx].abeg : state.storage[idx].end;
+        uintptr_t beg = ROUND_PAGE_SZ((uintptr_t) state.storage[idx].beg);
+        *pbeg = (void*) beg;
+        return (uintptr_t) end - beg;
+    } else {
+        return -1;
+    }
+}
+
 static bool txfunc (lwm_txinfo* txi) {
     txi->port = SVC_FRAG_PORT;
     txi->data = state.resp;
@@ -216,6 +256,7 @@ static int pkg_version_req (void) {
 
 static void frag_status_ans (int idx) {
     uint32_t total, complete;
+    state.stpend &= ~(1 << idx);
     if( idx >= SESSION_MAX || state.ps.sessions[idx].abeg == NULL
             || fuota_state(get_session(idx), NULL,
                 &total, NULL, &complete) == FUOTA_ERROR ) {
@@ -231,12 +272,46 @@ static void frag_status_ans (int idx) {
     state.resp[state.rlen++] = 0; // Status
 }
 
-static int frag_status_req (unsigned char* data, int dlen) {
+static void status_send (osjob_t* job) {
+    for( int i = 0; i < SESSION_MAX; i++ ) {
+        if( state.stpend & (1 << i) ) {
+            frag_status_ans(i);
+        }
+    }
+    if( state.rlen ) {
+        lwm_request_send(&state.lwmjob, 0, txfunc);
+    }
+}
+
+// schedule status answer after random delay of 0 to 2^(BlockAckDelay+4) seconds --
+// answers for several sessions are coalesced into the earliest scheduled uplink
+static void status_schedule (int idx) {
+    if( (state.stpend & (1 << idx)) == 0 ) {
+        uint32_t rnd = ((uint32_t) os_getRndU2() << 16) | os_getRndU2();
+        int dly = (idx < SESSION_MAX) ? state.ps.sessions[idx].delay : 0;
+        ostime_t t = os_getTime() + ms2osticks(rnd % (1000 << (dly + 4)));
+        if( state.stpend == 0 || t - state.sttime < 0 ) {
+            state.sttime = t;
+            os_setApproxTimedCallback(&state.stjob, t, status_send);
+        }
+        state.stpend |= (1 << idx);
+        debug_printf("frag: status for session %d pending in %t\r\n", idx, t - os_getTime());
+    }
+}
+
+static int frag_status_req (unsigned char* data, int dlen, unsigned int flags) {
     if( dlen < 2 ) {
         return -1;
     }
     int idx = (data[1] >> 1) & 3;
-    frag_status_ans(idx);
+    if( flags & LWM_FLAG_MCAST ) {
+        // multicast: only incomplete sessions answer unless all participants are asked
+        if( (data[1] & 1) || !session_complete(idx) ) {
+            status_schedule(idx);
+        }
+    } else {
+        frag_status_ans(idx);
+    }
     return 2;
 }
 
@@ -271,7 +346,8 @@ static int frag_sess_setup_req (unsigned char* data, int dlen) {
     } else if( state.ps.sessions[idx].abeg ) {
         // already allocated -- spec is ambiguous, we'll return an error here
         status |= SSA_STAT_IDX | SSA_STAT_MEM;
-    } else if( ((data[5] >> 3) & 3) != FRAG_ALGO_TRACKNET
+    } else if( (((data[5] >> 3) & 3) != FRAG_ALGO_TRACKNET
+                && ((data[5] >> 3) & 3) != FRAG_ALGO_STDFEC)
             || (data[4] & 3) != 0 ) {
         status |= SSA_STAT_ENC;
     } else {
@@ -293,7 +369,7 @@ static int frag_sess_setup_req (unsigned char* data, int dlen) {
             state.ps.sessions[idx].pad    = data[6];
             state.ps.sessions[idx].mcmask = data[1] & 7;
             state.ps.sessions[idx].algo   = (data[5] >> 3) & 3;
-            state.ps.sessions[idx].delay  = (data[5] >> 0) & 3;
+            state.ps.sessions[idx].delay  = (data[5] >> 0) & 7;
 
             fuota_session* fs = get_session(idx);
             void* mtrx = (void*) ((uintptr_t) fs - (dsz + msz));
@@ -301,7 +377,9 @@ static int frag_sess_setup_req (unsigned char* data, int dlen) {
             // erase pages
             flash_write(mtrx, NULL, size >> 2, true);
             // initialize state
-            fuota_init(fs, mtrx, cdat, state.ps.sessions[idx].desc, cct, cnw);
+            fuota_init_ex(fs, mtrx, cdat, state.ps.sessions[idx].desc, cct, cnw,
+                    (state.ps.sessions[idx].algo == FRAG_ALGO_STDFEC) ?
+                    FUOTA_ALGO_STDFEC : FUOTA_ALGO_TRACKNET);
             // save state to eeprom
             eefs_save(UFID_FRAG_SESSION, &state.ps, sizeof(pstate));
         }
@@ -323,6 +401,7 @@ static int frag_sess_del_req (unsigned char* data, int dlen) {
     } else {
         state.ps.sessions[idx].abeg = NULL;
         state.ps.sessions[idx].aend = NULL;
+        state.stpend &= ~(1 << idx);
         // save state to eeprom
         eefs_save(UFID_FRAG_SESSION, &state.ps, sizeof(pstate));
     }
@@ -332,20 +411,29 @@ static int frag_sess_del_req (unsigned char* data, int dlen) {
     return 2;
 }
 
-static int data_fragment (unsigned char* data, int dlen) {
+static int data_fragment (unsigned char* data, int dlen, unsigned int flags) {
     if( dlen > 3 ) {
         int idx_n = os_rlsbf2(data + 1);
         int idx = idx_n >> 14;
         int cid = idx_n & 0x3fff;
         if( idx < SESSION_MAX && state.storage[idx].beg != NULL ) {
             uint32_t cnw;
+            int st;
             fuota_session* fs = get_session(idx);
-            if( fuota_state(fs, NULL, NULL, &cnw, NULL) != FUOTA_ERROR
+            if( (st = fuota_state(fs, NULL, NULL, &cnw, NULL)) != FUOTA_ERROR
                     && dlen >= (cnw << 2)) {
-                fuota_process(fs, cid, data + 3);
-
-                // TODO - only generate status uplink on unicast
-                frag_status_ans(idx);
+                if( fuota_process(fs, cid, data + 3) == FUOTA_COMPLETE
+                        && st == FUOTA_MORE ) {
+                    debug_printf("frag: session %d complete\r\n", idx);
+                    SVCHOOK_frag_complete(idx);
+                    if( flags & LWM_FLAG_MCAST ) {
+                        // report completion once, after random delay
+                        status_schedule(idx);
+                    }
+                }
+                if( (flags & LWM_FLAG_MCAST) == 0 ) {
+                    frag_status_ans(idx);
+                }
 
                 return 3 + (cnw << 2);
             }
@@ -364,7 +452,7 @@ void _frag_dl (int port, unsigned char* data, int dlen, unsigned int flags) {
                     break;
 
                 case FRAG_STATUS_REQ:
-                    n = frag_status_req(data, dlen);
+                    n = frag_status_req(data, dlen, flags);
                     break;
 
                 case FRAG_SESS_SETUP_REQ:
@@ -376,7 +464,7 @@ void _frag_dl (int port, unsigned char* data, int dlen, unsigned int flags) {
                     break;
 
                 case DATA_FRAGMENT:
-                    n = data_fragment(data, dlen);
+                    n = data_fragment(data, dlen, flags);
                     break;
 
 #ifdef SVC_FRAG_TEST
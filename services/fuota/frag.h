@@ -6,8 +6,14 @@
 #ifndef _frag_h_
 #define _frag_h_
 
+#include <stdint.h>
+#include <stdbool.h>
+
 void _frag_init (int nsessions, void** sbeg, void** send);
 
 int frag_get (int idx, void** pdata);
+int frag_get_spare (int idx, void** pbeg);
+void frag_set_digest (int idx, const uint32_t* digest);
+bool frag_get_digest (int idx, uint32_t* digest);
 
 #endif
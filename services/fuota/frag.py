@@ -7,10 +7,42 @@
 
 from typing import BinaryIO,Callable,List,Optional,Union
 
+import ctypes
+import os
 import random
 import struct
 from bitarray import bitarray
 
+class NativeEncoder:
+    """Bindings for the batch carousel encoder in libfragenc.so (TrackNet generator only)."""
+    lib:Optional[ctypes.CDLL] = None
+
+    @staticmethod
+    def load() -> Optional[ctypes.CDLL]:
+        if NativeEncoder.lib is None:
+            fn = os.environ.get('FRAGENC_LIB',
+                    os.path.join(os.path.dirname(os.path.abspath(__file__)), 'libfragenc.so'))
+            try:
+                lib = ctypes.CDLL(fn)
+            except OSError:
+                return None
+            lib.fragenc_gen.restype = None
+            lib.fragenc_gen.argtypes = [ctypes.c_char_p, ctypes.c_char_p,
+                    ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_int]
+            NativeEncoder.lib = lib
+        return NativeEncoder.lib
+
+    @staticmethod
+    def generate(data:bytes, csz:int, cid_beg:int, cid_end:int, nthreads:int=0) -> bytes:
+        lib = NativeEncoder.load()
+        if lib is None:
+            raise RuntimeError('libfragenc.so not available')
+        cct = len(data) // csz
+        n = cid_end - cid_beg
+        buf = ctypes.create_string_buffer(n * csz)
+        lib.fragenc_gen(buf, data, cct, csz // 4, cid_beg, cid_end, nthreads)
+        return buf.raw
+
 def bitarrayfrombytes(buf:bytes) -> bitarray:
     b = bitarray(endian='little')
     b.frombytes(buf)
@@ -34,6 +66,32 @@ class TrackNetGenerator(CBGenerator):
         b = bitarrayfrombytes(struct.pack('<%dI' % nw, *(self.tn_avalanche((cid * nw) + i) for i in range(nw))))
         return b[:cct]
 
+class StdFecGenerator(CBGenerator):
+    """LoRaWAN fragmented data block transport parity matrix (FragAlgo 0), cid is 1-based."""
+    @staticmethod
+    def prbs23(x:int) -> int:
+        b0 = x & 1
+        b1 = (x & 32) >> 5
+        return (x >> 1) + ((b0 ^ b1) << 22)
+
+    def generate(self, cct:int, cid:int) -> bitarray:
+        b = bitarray(cct, endian='little')
+        b.setall(0)
+        if cid <= 0:
+            return b
+        if cid <= cct:
+            b[cid - 1] = 1
+            return b
+        m = 1 if (cct & (cct - 1)) == 0 else 0
+        x = 1 + (1001 * (cid - cct))
+        for _ in range(cct // 2):
+            r = cct
+            while r >= cct:
+                x = self.prbs23(x)
+                r = x % (cct + m)
+            b[r] = 1
+        return b
+
 class FragCarousel:
     def __init__(self, data:bytes, csz:int, cbg:CBGenerator, pad:int=0) -> None:
         cct,rem = divmod(len(data), csz)
@@ -45,10 +103,20 @@ class FragCarousel:
         self.cbg = cbg
         self.pad = pad
         self.blocks = [bitarrayfrombytes(data[b*csz:(b+1)*csz]) for b in range(cct)]
+        self.native = (isinstance(cbg, TrackNetGenerator) and (csz & 3) == 0
+                and NativeEncoder.load() is not None)
+
+    def chunks(self, cid_beg:int, cid_end:int) -> List[bytes]:
+        if self.native:
+            buf = NativeEncoder.generate(self.data, self.csz, cid_beg, cid_end)
+            return [buf[i*self.csz:(i+1)*self.csz] for i in range(cid_end - cid_beg)]
+        return [self.chunk(cid) for cid in range(cid_beg, cid_end)]
 
     def chunk(self, cid:int) -> bytes:
+        if self.native:
+            return NativeEncoder.generate(self.data, self.csz, cid, cid + 1, 1)
         cb = self.cbg.generate(self.cct, cid)
-        chunk = bitarray(self.csz * 8)
+        chunk = bitarray(self.csz * 8, endian='little')
         chunk.setall(0)
         for c in range(self.cct):
             if cb[c]:
@@ -0,0 +1,143 @@
+// Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+//
+// This file is subject to the terms and conditions defined in file 'LICENSE',
+// which is part of this source code package.
+
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "fragenc.h"
+
+// ------------------------------------------------
+// Checkbit generator (must match fuota.c)
+
+#define G_WORDS(n)      ((n + 31) >> 5)
+
+static uint32_t g_avalanche (uint32_t x) {
+    x = ((x >> 16) ^ x) * 0x45d9f3b;
+    x = ((x >> 16) ^ x) * 0x45d9f3b;
+    x = (x >> 16) ^ x;
+    return x;
+}
+
+static void g_checkbits (uint32_t chunk_id, uint32_t* row, uint32_t chunk_ct) {
+    uint32_t i, n = G_WORDS(chunk_ct);
+    for (i = 0; i < n; i++) {
+        row[i] = g_avalanche((chunk_id * n) + i);
+    }
+    uint32_t mask = (1u << (chunk_ct & 31)) - 1;
+    if (mask) {
+        row[i - 1] &= mask;
+    }
+}
+
+
+// ------------------------------------------------
+// XOR
+
+// 32-byte vectors -- the compiler maps these to SSE/AVX/NEON registers
+typedef uint32_t v8u4 __attribute__((vector_size(32)));
+
+static void xor_blk (uint32_t* dst, const uint32_t* src, uint32_t nwords) {
+    uint32_t i = 0;
+    for (; i + 8 <= nwords; i += 8) {
+        v8u4 a, b;
+        memcpy(&a, dst + i, sizeof(a));
+        memcpy(&b, src + i, sizeof(b));
+        a ^= b;
+        memcpy(dst + i, &a, sizeof(a));
+    }
+    for (; i + 2 <= nwords; i += 2) {
+        uint64_t a, b;
+        memcpy(&a, dst + i, sizeof(a));
+        memcpy(&b, src + i, sizeof(b));
+        a ^= b;
+        memcpy(dst + i, &a, sizeof(a));
+    }
+    if (i < nwords) {
+        dst[i] ^= src[i];
+    }
+}
+
+
+// ------------------------------------------------
+// Batch generator
+
+typedef struct {
+    uint32_t* dst;
+    const uint32_t* src;
+    uint32_t chunk_ct;
+    uint32_t chunk_nw;
+    uint32_t cid_beg;
+    uint32_t cid_end;
+} gen_job;
+
+// number of chunks generated together -- each data block is read once per tile
+#define TILE_CT 32
+
+static void* gen_range (void* arg) {
+    gen_job* job = arg;
+    uint32_t nw = job->chunk_nw;
+    uint32_t gw = G_WORDS(job->chunk_ct);
+    uint32_t* c = malloc(TILE_CT * gw * 4);
+    for (uint32_t cid = job->cid_beg; cid != job->cid_end; ) {
+        uint32_t n = job->cid_end - cid;
+        if (n > TILE_CT) {
+            n = TILE_CT;
+        }
+        uint32_t* dst = job->dst + ((cid - job->cid_beg) * nw);
+        for (uint32_t j = 0; j < n; j++) {
+            g_checkbits(cid + j, c + (j * gw), job->chunk_ct);
+        }
+        memset(dst, 0x00, (n * nw) << 2);
+        for (uint32_t i = 0; i < job->chunk_ct; i++) {
+            const uint32_t* blk = job->src + (nw * i);
+            uint32_t idx = i >> 5, mask = 1u << (i & 31);
+            for (uint32_t j = 0; j < n; j++) {
+                if (c[(j * gw) + idx] & mask) {
+                    xor_blk(dst + (j * nw), blk, nw);
+                }
+            }
+        }
+        cid += n;
+    }
+    free(c);
+    return NULL;
+}
+
+void fragenc_gen (uint32_t* dst, const uint32_t* src,
+        uint32_t chunk_ct, uint32_t chunk_nw,
+        uint32_t cid_beg, uint32_t cid_end, int nthreads) {
+    uint32_t n = cid_end - cid_beg;
+    if (nthreads <= 0) {
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (nthreads > n) {
+        nthreads = n;
+    }
+    if (nthreads <= 1) {
+        gen_job job = { dst, src, chunk_ct, chunk_nw, cid_beg, cid_end };
+        gen_range(&job);
+        return;
+    }
+    gen_job jobs[nthreads];
+    pthread_t threads[nthreads];
+    int started[nthreads];
+    uint32_t cid = cid_beg;
+    for (int t = 0; t < nthreads; t++) {
+        uint32_t cnt = (n / nthreads) + ((t < (n % nthreads)) ? 1 : 0);
+        jobs[t] = (gen_job) { dst + ((cid - cid_beg) * chunk_nw), src,
+            chunk_ct, chunk_nw, cid, cid + cnt };
+        cid += cnt;
+        if (!(started[t] = (pthread_create(&threads[t], NULL, gen_range, &jobs[t]) == 0))) {
+            gen_range(&jobs[t]); // fall back to calling thread
+        }
+    }
+    for (int t = 0; t < nthreads; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+}
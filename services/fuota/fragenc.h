@@ -0,0 +1,26 @@
+// Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+//
+// This file is subject to the terms and conditions defined in file 'LICENSE',
+// which is part of this source code package.
+
+// Host-side fragmentation carousel encoder. Generates the same chunks as
+// fuota_gen_chunk(), but in batches and spread over multiple threads.
+
+#ifndef _fragenc_h_
+#define _fragenc_h_
+
+#include <stdint.h>
+
+// generate chunks for a range of chunk identifiers
+// - dst:       output buffer, (cid_end - cid_beg) * chunk_nw words
+// - src:       padded input data, chunk_ct * chunk_nw words
+// - chunk_ct:  chunk count
+// - chunk_nw:  number of 4-byte words per chunk
+// - cid_beg:   first chunk identifier
+// - cid_end:   chunk identifier past the last one generated
+// - nthreads:  number of worker threads (0 for one per online CPU)
+void fragenc_gen (uint32_t* dst, const uint32_t* src,
+        uint32_t chunk_ct, uint32_t chunk_nw,
+        uint32_t cid_beg, uint32_t cid_end, int nthreads);
+
+#endif
@@ -24,12 +24,16 @@ struct _fuota_session {
 
     uint32_t* matrix;   // pointer to matrix
     uint32_t* blocks;   // pointer to data blocks
+
+    uint32_t digest[8]; // application digest of unpacked data (write-once)
+    uint32_t digested;  // tainted when digest is valid
 };
 
 _Static_assert(sizeof(fuota_session) <= fuota_flash_pagesz,
         "fuota_session must fit into single Flash page");
 
-#define FUOTA_MAGIC     0x03291982
+#define FUOTA_MAGIC         0x03291982  // TrackNet checkbits
+#define FUOTA_MAGIC_STDFEC  0x03291983  // LoRaWAN parity matrix
 
 
 // ------------------------------------------------
@@ -194,8 +198,8 @@ static uint32_t g_avalanche (uint32_t x) {
     return x;
 }
 
-// generate checkbits for chunk
-static void g_checkbits (uint32_t chunk_id, uint32_t* row, uint32_t chunk_ct) {
+// generate TrackNet checkbits for chunk
+static void g_tracknet (uint32_t chunk_id, uint32_t* row, uint32_t chunk_ct) {
     uint32_t i, n = G_WORDS(chunk_ct);
     for (i = 0; i < n; i++) {
         row[i] = g_avalanche((chunk_id * n) + i);
@@ -206,6 +210,46 @@ static void g_checkbits (uint32_t chunk_id, uint32_t* row, uint32_t chunk_ct) {
     }
 }
 
+// 23bit pseudo-random binary sequence
+static uint32_t g_prbs23 (uint32_t x) {
+    uint32_t b0 = x & 1;
+    uint32_t b1 = (x & 32) >> 5;
+    return (x >> 1) + ((b0 ^ b1) << 22);
+}
+
+// generate checkbits for chunk according to the LoRaWAN fragmented
+// data block transport parity matrix -- fragments 1..chunk_ct are
+// uncoded, the following ones are parity fragments
+static void g_stdfec (uint32_t chunk_id, uint32_t* row, uint32_t chunk_ct) {
+    memset(row, 0, G_WORDS(chunk_ct) << 2);
+    if (chunk_id == 0) {
+        return; // invalid fragment index
+    }
+    if (chunk_id <= chunk_ct) {
+        row[M_BITIDX(chunk_id - 1)] = M_BITMSK(chunk_id - 1);
+        return;
+    }
+    uint32_t m = ((chunk_ct & (chunk_ct - 1)) == 0) ? 1 : 0;
+    uint32_t x = 1 + (1001 * (chunk_id - chunk_ct));
+    for (uint32_t n = 0; n < (chunk_ct >> 1); n++) {
+        uint32_t r;
+        do {
+            x = g_prbs23(x);
+            r = x % (chunk_ct + m);
+        } while (r >= chunk_ct);
+        row[M_BITIDX(r)] |= M_BITMSK(r);
+    }
+}
+
+// generate checkbits for chunk
+static void g_checkbits (int algo, uint32_t chunk_id, uint32_t* row, uint32_t chunk_ct) {
+    if (algo == FUOTA_ALGO_STDFEC) {
+        g_stdfec(chunk_id, row, chunk_ct);
+    } else {
+        g_tracknet(chunk_id, row, chunk_ct);
+    }
+}
+
 
 // ------------------------------------------------
 // API
@@ -213,8 +257,11 @@ static void g_checkbits (uint32_t chunk_id, uint32_t* row, uint32_t chunk_ct) {
 #define s_u4(f)         fuota_flash_rd_u4(&session->f)
 #define s_u4ptr(f)      ((uint32_t*) fuota_flash_rd_ptr(&session->f))
 
+#define s_algo()        ((s_u4(magic) == FUOTA_MAGIC_STDFEC) ? FUOTA_ALGO_STDFEC : FUOTA_ALGO_TRACKNET)
+
 static bool check_session (fuota_session* session) {
-    return s_u4(magic) == FUOTA_MAGIC
+    uint32_t magic = s_u4(magic);
+    return (magic == FUOTA_MAGIC || magic == FUOTA_MAGIC_STDFEC)
         && !(s_u4(unpacking) != FLASH_UNTAINTED && s_u4(done) == FLASH_UNTAINTED);
 }
 
@@ -223,11 +270,11 @@ size_t fuota_matrix_size (uint32_t chunk_ct, uint32_t chunk_nw) {
     return (m_nw << 2);
 }
 
-void fuota_init (void* session, void* matrix, void* data, uint32_t sid,
-        uint32_t chunk_ct, uint32_t chunk_nw) {
+void fuota_init_ex (void* session, void* matrix, void* data, uint32_t sid,
+        uint32_t chunk_ct, uint32_t chunk_nw, int algo) {
     fuota_session s;
 
-    s.magic = FUOTA_MAGIC;
+    s.magic = (algo == FUOTA_ALGO_STDFEC) ? FUOTA_MAGIC_STDFEC : FUOTA_MAGIC;
     s.sid = sid;
     s.chunk_ct = chunk_ct;
     s.chunk_nw = chunk_nw;
@@ -239,7 +286,13 @@ void fuota_init (void* session, void* matrix, void* data, uint32_t sid,
     s.matrix = matrix;
     s.blocks = data;
 
-    fuota_flash_write(session, &s, sizeof(fuota_session) >> 2, false);
+    // digest is written later
+    fuota_flash_write(session, &s, offsetof(fuota_session, digest) >> 2, false);
+}
+
+void fuota_init (void* session, void* matrix, void* data, uint32_t sid,
+        uint32_t chunk_ct, uint32_t chunk_nw) {
+    fuota_init_ex(session, matrix, data, sid, chunk_ct, chunk_nw, FUOTA_ALGO_TRACKNET);
 }
 
 void* fuota_unpack (fuota_session* session) {
@@ -297,7 +350,7 @@ int fuota_process (fuota_session* session, uint32_t chunk_id,
     memcpy(d, chunk_buf, chunk_nw << 2);
     // generate checkbits
     uint32_t c[G_WORDS(chunk_ct)];
-    g_checkbits(chunk_id, c, chunk_ct);
+    g_checkbits(s_algo(), chunk_id, c, chunk_ct);
     // process against already received chunks
     uint32_t* matrix = s_u4ptr(matrix);
     uint32_t i = chunk_ct, idx = M_BITIDX(i), mask = M_BITMSK(i);
@@ -352,6 +405,24 @@ int fuota_state (fuota_session* session, uint32_t* sid,
     return FUOTA_MORE;
 }
 
+void fuota_set_digest (fuota_session* session, const uint32_t* digest) {
+    if (check_session(session) && s_u4(done) != FLASH_UNTAINTED
+            && s_u4(digested) == FLASH_UNTAINTED) {
+        uint32_t d[8];
+        memcpy(d, digest, sizeof(d));
+        fuota_flash_write(session->digest, d, 8, false);
+        word_taint(&session->digested);
+    }
+}
+
+bool fuota_get_digest (fuota_session* session, uint32_t* digest) {
+    if (check_session(session) && s_u4(digested) != FLASH_UNTAINTED) {
+        fuota_flash_read(digest, session->digest, 8);
+        return true;
+    }
+    return false;
+}
+
 int fuota_check_state (fuota_session* session, uint32_t sid,
         uint32_t chunk_ct, uint32_t chunk_nw) {
     uint32_t c_sid, c_chunk_ct, c_chunk_nw;
@@ -376,10 +447,10 @@ static void xor_r2r (uint32_t* dest, uint32_t* src, uint32_t nwords) {
     }
 }
 
-void fuota_gen_chunk (uint32_t* dst, uint32_t* src, uint32_t chunk_id,
-        uint32_t chunk_ct, uint32_t chunk_nw) {
+void fuota_gen_chunk_ex (uint32_t* dst, uint32_t* src, uint32_t chunk_id,
+        uint32_t chunk_ct, uint32_t chunk_nw, int algo) {
     uint32_t c[G_WORDS(chunk_ct)];
-    g_checkbits(chunk_id, c, chunk_ct);
+    g_checkbits(algo, chunk_id, c, chunk_ct);
     memset(dst, 0x00, chunk_nw * 4);
     uint32_t i = chunk_ct, idx = M_BITIDX(i), mask = M_BITMSK(i);
     while (i-- > 0) {
@@ -390,4 +461,9 @@ void fuota_gen_chunk (uint32_t* dst, uint32_t* src, uint32_t chunk_id,
     }
 }
 
+void fuota_gen_chunk (uint32_t* dst, uint32_t* src, uint32_t chunk_id,
+        uint32_t chunk_ct, uint32_t chunk_nw) {
+    fuota_gen_chunk_ex(dst, src, chunk_id, chunk_ct, chunk_nw, FUOTA_ALGO_TRACKNET);
+}
+
 #endif
@@ -8,6 +8,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 enum {
     FUOTA_MORE          = 0,
@@ -16,6 +17,12 @@ enum {
     FUOTA_ERROR         = -1,
 };
 
+// check bits generators (values match LoRaWAN FragAlgo)
+enum {
+    FUOTA_ALGO_STDFEC   = 0,    // LoRaWAN fragmented data block transport parity matrix
+    FUOTA_ALGO_TRACKNET = 1,    // TrackNet pseudo-random check bits
+};
+
 struct _fuota_session;
 typedef struct _fuota_session fuota_session;
 
@@ -38,6 +45,14 @@ size_t fuota_matrix_size (uint32_t chunk_ct, uint32_t chunk_nw);
 void fuota_init (void* session, void* matrix, void* data, uint32_t sid,
         uint32_t chunk_ct, uint32_t chunk_nw);
 
+// initialize a session using the specified check bits generator
+// - algo:      FUOTA_ALGO_STDFEC or FUOTA_ALGO_TRACKNET
+// - (see fuota_init for other parameters)
+// NOTE: For FUOTA_ALGO_STDFEC chunk identifiers are the 1-based fragment
+//       indices; identifiers 1 to chunk_ct are the uncoded chunks.
+void fuota_init_ex (void* session, void* matrix, void* data, uint32_t sid,
+        uint32_t chunk_ct, uint32_t chunk_nw, int algo);
+
 // process a chunk
 // - session:   pointer to session
 // - chunk_id:  chunk identifier
@@ -57,9 +72,18 @@ int fuota_check_state (fuota_session* session, uint32_t sid,
 // - session:   pointer to session
 void* fuota_unpack (fuota_session* session);
 
+// store a digest (8 words) of the unpacked data in the session page;
+// can only be set once, after unpacking
+void fuota_set_digest (fuota_session* session, const uint32_t* digest);
+
+// get the stored digest, returns false if no digest has been set
+bool fuota_get_digest (fuota_session* session, uint32_t* digest);
+
 #ifdef FUOTA_GENERATOR
 void fuota_gen_chunk (uint32_t* dst, uint32_t* src, uint32_t chunk_id,
         uint32_t chunk_ct, uint32_t chunk_nw);
+void fuota_gen_chunk_ex (uint32_t* dst, uint32_t* src, uint32_t chunk_id,
+        uint32_t chunk_ct, uint32_t chunk_nw, int algo);
 #endif
 
 #endif
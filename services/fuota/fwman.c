@@ -15,6 +15,8 @@
 #include "fuota/micro-ecc/uECC.h"
 
 #include "frag.h"
+#include "delta.h"
+#include "sha256.h"
 
 #ifndef SVC_FWMAN_PORT
 #define SVC_FWMAN_PORT 203
@@ -24,6 +26,11 @@
 #define SVC_FWMAN_UPDATE_FRAG_IDX 0
 #endif
 
+#ifndef SVC_FWMAN_HASH_SLICE
+#define SVC_FWMAN_HASH_SLICE 1024 // bytes hashed per job
+#endif
+#define HASH_SLICE SVC_FWMAN_HASH_SLICE
+
 #ifdef SVC_FWMAN_PUBKEY
 extern const unsigned char* SVC_FWMAN_PUBKEY (void);
 #else
@@ -78,6 +85,12 @@ static struct {
 
     lwm_job lwmjob;             // uplink job
     osjob_t rebootjob;          // reboot job
+
+    osjob_t hashjob;            // background hashing job
+    sha256_ctx hctx;            // hash context
+    const uint8_t* hptr;        // update being hashed
+    uint32_t hpos;              // number of bytes hashed
+    uint32_t hlen;              // size of update
 } state;
 
 // ensure that there is at least n bytes available in the
@@ -131,18 +144,18 @@ static int dev_version_req (void) {
     return 1;
 }
 
-static bool check_sig (void* ptr, int len) {
+static bool check_sig (void* ptr, unsigned char* sig, int len) {
     const unsigned char* pubkey = SVC_FWMAN_PUBKEY();
     uECC_Curve curve = SVC_FWMAN_CURVE();
     int sigsize = uECC_curve_private_key_size(curve) << 1;
 
     boot_uphdr* up = ptr;
-    unsigned char* sig = ptr;
     uint32_t hash[8];
-    sha256(hash, ptr, up->size);
+    // use digest computed in background if available
+    if( !frag_get_digest(SVC_FWMAN_UPDATE_FRAG_IDX, hash) ) {
+        sha256(hash, ptr, up->size);
+    }
 
-    sig += up->size;
-    len -= up->size;
     while( len >= sigsize ) {
         if( uECC_verify(pubkey, (unsigned char*) hash, 32, sig, curve) == 1 ) {
             debug_str("fwman: signature verified\r\n");
@@ -156,29 +169,139 @@ static bool check_sig (void* ptr, int len) {
     return false;
 }
 
-static int check_img (uint32_t* pcrc, void** pdata) {
+// check format, length, and crc of update
+static bool check_crc (void* ptr, int len) {
+    boot_uphdr* up = ptr;
+    return len >= sizeof(boot_uphdr)
+        && (up->size & 3) == 0
+        && len >= up->size
+        && crc32((unsigned char*) ptr + 8, (up->size - 8) >> 2) == up->crc;
+}
+
+typedef struct {
+    void* ptr;                  // update
+    unsigned char* sig;         // signatures
+    int siglen;                 // length of signatures
+} img_info;
+
+// reconstruct delta or compressed update in front of the fragmentation
+// session (src is NULL for compressed updates)
+static int find_rebuilt (void* ptr, int len, uint32_t size, uint32_t dstsize,
+        const void* src, img_info* img) {
+    void* slot;
+    int slen = frag_get_spare(SVC_FWMAN_UPDATE_FRAG_IDX, &slot);
+
+    if( (size & 3) != 0
+            || len < size
+            || slen < 0 || dstsize > (uint32_t) slen ) {
+        return DUI_STAT_INVALID;
+    }
+    // reuse previously reconstructed update if intact
+    if( !check_crc(slot, dstsize) || ((boot_uphdr*) slot)->size != dstsize ) {
+        debug_str("fwman: reconstructing update\r\n");
+        if( (src ? delta_apply(ptr, src, slot) : lz_apply(ptr, slot)) != dstsize
+                || !check_crc(slot, dstsize) ) {
+            return DUI_STAT_INVALID;
+        }
+    }
+    img->ptr = slot;
+    img->sig = (unsigned char*) ptr + size;
+    img->siglen = len - size;
+    return DUI_STAT_VALID;
+}
+
+static int find_delta (delta_hdr* dh, int len, img_info* img) {
+    hal_fwi fwi;
+    hal_fwinfo(&fwi);
+
+    if( len < sizeof(delta_hdr) || dh->size < sizeof(delta_hdr) ) {
+        return DUI_STAT_INVALID;
+    }
+    if( dh->srccrc != fwi.crc || dh->srcsize != fwi.size ) {
+        return DUI_STAT_MISMATCH;
+    }
+    return find_rebuilt(dh, len, dh->size, dh->dstsize, fwi.base, img);
+}
+
+static int find_lz (lz_hdr* lh, int len, img_info* img) {
+    if( len < sizeof(lz_hdr) || lh->size < sizeof(lz_hdr) ) {
+        return DUI_STAT_INVALID;
+    }
+    return find_rebuilt(lh, len, lh->size, lh->dstsize, NULL, img);
+}
+
+// locate update and check crc (signatures are not checked)
+static int find_img (img_info* img) {
     void* ptr;
     int len;
     if( (len = frag_get(SVC_FWMAN_UPDATE_FRAG_IDX, &ptr)) < 0 ) {
         return DUI_STAT_NONE;
+    } else if( len >= sizeof(uint32_t) && *((uint32_t*) ptr) == DELTA_MAGIC ) {
+        return find_delta(ptr, len, img);
+    } else if( len >= sizeof(uint32_t) && *((uint32_t*) ptr) == LZ_MAGIC ) {
+        return find_lz(ptr, len, img);
+    } else if( !check_crc(ptr, len) ) {
+        return DUI_STAT_INVALID;
     } else {
-        // check format, length, crc, and signatures
-        boot_uphdr* up = ptr;
-        if( len < sizeof(boot_uphdr)
-                || (up->size & 3) != 0
-                || len < up->size
-                || crc32((unsigned char*) ptr + 8, (up->size - 8) >> 2) != up->crc
-                || !check_sig(ptr, len) ) {
+        img->ptr = ptr;
+        img->sig = (unsigned char*) ptr + ((boot_uphdr*) ptr)->size;
+        img->siglen = len - ((boot_uphdr*) ptr)->size;
+        return DUI_STAT_VALID;
+    }
+}
+
+static int check_img (uint32_t* pcrc, void** pdata) {
+    img_info img;
+    int status = find_img(&img);
+    if( status == DUI_STAT_VALID ) {
+        if( !check_sig(img.ptr, img.sig, img.siglen) ) {
             return DUI_STAT_INVALID;
-        } else {
-            if( pcrc ) {
-                *pcrc = up->fwcrc;
-            }
-            if( pdata ) {
-                *pdata = ptr;
-            }
-            return DUI_STAT_VALID;
         }
+        if( pcrc ) {
+            *pcrc = ((boot_uphdr*) img.ptr)->fwcrc;
+        }
+        if( pdata ) {
+            *pdata = img.ptr;
+        }
+    }
+    return status;
+}
+
+// hash update in slices, so other jobs can run in between
+static void hash_step (osjob_t* job) {
+    uint32_t n = state.hlen - state.hpos;
+    if( n > HASH_SLICE ) {
+        n = HASH_SLICE;
+    }
+    sha256_update(&state.hctx, state.hptr + state.hpos, n);
+    state.hpos += n;
+    if( state.hpos < state.hlen ) {
+        os_setCallback(job, hash_step);
+    } else {
+        uint32_t digest[8];
+        sha256_final(&state.hctx, digest);
+        frag_set_digest(SVC_FWMAN_UPDATE_FRAG_IDX, digest);
+        debug_str("fwman: update hashed\r\n");
+    }
+}
+
+static void hash_start (osjob_t* job) {
+    uint32_t digest[8];
+    img_info img;
+    if( !frag_get_digest(SVC_FWMAN_UPDATE_FRAG_IDX, digest)
+            && find_img(&img) == DUI_STAT_VALID ) {
+        state.hptr = img.ptr;
+        state.hpos = 0;
+        state.hlen = ((boot_uphdr*) img.ptr)->size;
+        sha256_init(&state.hctx);
+        os_setCallback(job, hash_step);
+    }
+}
+
+// fragmentation session complete -- start hashing update in background
+void _fwman_frag_complete (int idx) {
+    if( idx == SVC_FWMAN_UPDATE_FRAG_IDX ) {
+        os_setCallback(&state.hashjob, hash_start);
     }
 }
 
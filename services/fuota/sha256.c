@@ -0,0 +1,105 @@
+// Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+//
+// This file is subject to the terms and conditions defined in file 'LICENSE',
+// which is part of this source code package.
+
+#include <string.h>
+
+#include "sha256.h"
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x,n)    (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void transform (uint32_t* s, const uint8_t* p) {
+    uint32_t w[16];
+    uint32_t a = s[0], b = s[1], c = s[2], d = s[3];
+    uint32_t e = s[4], f = s[5], g = s[6], h = s[7];
+    for( int i = 0; i < 64; i++ ) {
+        if( i < 16 ) {
+            w[i] = ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+            p += 4;
+        } else {
+            uint32_t w15 = w[(i + 1) & 15], w2 = w[(i + 14) & 15];
+            w[i & 15] += (ROR(w15, 7) ^ ROR(w15, 18) ^ (w15 >> 3))
+                + w[(i + 9) & 15]
+                + (ROR(w2, 17) ^ ROR(w2, 19) ^ (w2 >> 10));
+        }
+        uint32_t t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25))
+            + ((e & f) ^ (~e & g)) + K[i] + w[i & 15];
+        uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22))
+            + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+    s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+}
+
+void sha256_init (sha256_ctx* ctx) {
+    static const uint32_t H0[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, H0, sizeof(H0));
+    ctx->count = 0;
+}
+
+void sha256_update (sha256_ctx* ctx, const void* data, uint32_t len) {
+    const uint8_t* p = data;
+    uint32_t off = ctx->count & 63;
+    ctx->count += len;
+    if( off ) {
+        uint32_t n = 64 - off;
+        if( n > len ) {
+            n = len;
+        }
+        memcpy(ctx->buf + off, p, n);
+        p += n;
+        len -= n;
+        if( off + n < 64 ) {
+            return;
+        }
+        transform(ctx->state, ctx->buf);
+    }
+    while( len >= 64 ) {
+        transform(ctx->state, p);
+        p += 64;
+        len -= 64;
+    }
+    memcpy(ctx->buf, p, len);
+}
+
+void sha256_final (sha256_ctx* ctx, uint32_t* hash) {
+    uint32_t bits = ctx->count << 3;
+    uint32_t off = ctx->count & 63;
+    ctx->buf[off++] = 0x80;
+    if( off > 56 ) {
+        memset(ctx->buf + off, 0, 64 - off);
+        transform(ctx->state, ctx->buf);
+        off = 0;
+    }
+    memset(ctx->buf + off, 0, 60 - off);
+    ctx->buf[60] = bits >> 24;
+    ctx->buf[61] = bits >> 16;
+    ctx->buf[62] = bits >> 8;
+    ctx->buf[63] = bits;
+    ctx->buf[59] = ctx->count >> 29;
+    transform(ctx->state, ctx->buf);
+    uint8_t* h = (uint8_t*) hash;
+    for( int i = 0; i < 8; i++ ) {
+        h[(i << 2) + 0] = ctx->state[i] >> 24;
+        h[(i << 2) + 1] = ctx->state[i] >> 16;
+        h[(i << 2) + 2] = ctx->state[i] >> 8;
+        h[(i << 2) + 3] = ctx->state[i];
+    }
+}
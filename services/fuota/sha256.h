@@ -0,0 +1,24 @@
+// Copyright (C) 2016-2020 Semtech (International) AG. All rights reserved.
+//
+// This file is subject to the terms and conditions defined in file 'LICENSE',
+// which is part of this source code package.
+
+#ifndef _sha256_h_
+#define _sha256_h_
+
+#include <stdint.h>
+
+// Incremental SHA-256 -- the digest is written in the same format as the
+// one-shot sha256() function provided by the HAL.
+
+typedef struct {
+    uint32_t state[8];
+    uint32_t count;             // number of bytes processed
+    uint8_t buf[64];            // pending partial block
+} sha256_ctx;
+
+void sha256_init (sha256_ctx* ctx);
+void sha256_update (sha256_ctx* ctx, const void* data, uint32_t len);
+void sha256_final (sha256_ctx* ctx, uint32_t* hash);
+
+#endif
@@ -5,6 +5,9 @@
 
 #include "fuota.h"
 #include "fuota_hal.h"
+#include "fragenc.h"
+#include "delta.h"
+#include "sha256.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -109,6 +112,191 @@ static uint32_t readfile (unsigned char** pbuf, const char* fn, uint32_t chunk_n
     return msize >> 2;
 }
 
+// ------------------------------------------------
+// Delta and compressed updates
+
+static uint8_t* put_varint (uint8_t* p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static uint8_t* put_copy (uint8_t* p, uint32_t len, uint32_t arg) {
+    return put_varint(put_varint(p, len << 1), arg);
+}
+
+static uint8_t* put_lit (uint8_t* p, const uint8_t* data, uint32_t len) {
+    p = put_varint(p, (len << 1) | 1);
+    memcpy(p, data, len);
+    return p + len;
+}
+
+static uint32_t zigzag (int32_t v) {
+    return (v << 1) ^ (v >> 31);
+}
+
+static void test_delta (void) {
+    static uint32_t cbuf[256];
+    static uint8_t src[1000], exp[2000];
+    void* dst = word2addr(0);
+    uint8_t* out = (uint8_t*) FLASH.W;
+    delta_hdr* dh = (delta_hdr*) cbuf;
+    lz_hdr* lh = (lz_hdr*) cbuf;
+    uint8_t* p;
+    uint32_t n;
+
+    for (int i = 0; i < sizeof(src); i++) {
+        src[i] = rand();
+    }
+
+    // delta: copy, literal, backwards copy, copy to end of source
+    memset(cbuf, 0, sizeof(cbuf));
+    p = (uint8_t*) (dh + 1);
+    p = put_copy(p, 300, zigzag(10));           // src[10..310)
+    p = put_lit(p, (uint8_t*) "hello", 5);
+    p = put_copy(p, 200, zigzag(-250));         // src[60..260)
+    p = put_copy(p, 100, zigzag(640));          // src[900..1000)
+    n = 0;
+    memcpy(exp + n, src + 10, 300); n += 300;
+    memcpy(exp + n, "hello", 5);    n += 5;
+    memcpy(exp + n, src + 60, 200); n += 200;
+    memcpy(exp + n, src + 900, 100); n += 100;
+    *dh = (delta_hdr) {
+        .magic = DELTA_MAGIC,
+        .size = (p - (uint8_t*) cbuf + 3) & ~3,
+        .srcsize = sizeof(src),
+        .dstsize = n,
+    };
+    assert(delta_apply(dh, src, dst) == n);
+    assert(memcmp(out, exp, n) == 0);
+
+    // delta: malformed containers
+    dh->dstsize = n + 1;                        // op stream too short
+    assert(delta_apply(dh, src, dst) == -1);
+    dh->dstsize = n - 1;                        // output exceeds dstsize
+    assert(delta_apply(dh, src, dst) == -1);
+    dh->dstsize = n;
+    dh->size = sizeof(delta_hdr) - 4;           // size smaller than header
+    assert(delta_apply(dh, src, dst) == -1);
+    dh->size = 0;
+    assert(delta_apply(dh, src, dst) == -1);
+    dh->srcsize = 999;                          // copy beyond end of source
+    dh->size = (p - (uint8_t*) cbuf + 3) & ~3;
+    assert(delta_apply(dh, src, dst) == -1);
+    dh->srcsize = sizeof(src);
+    p = (uint8_t*) (dh + 1);
+    p = put_varint(p, (100 << 1) | 1);          // literal beyond end of stream
+    dh->size = p - (uint8_t*) cbuf + 8;
+    dh->dstsize = 100;
+    assert(delta_apply(dh, src, dst) == -1);
+    p = (uint8_t*) (dh + 1);
+    *p++ = 0x80;                                // truncated varint
+    dh->size = p - (uint8_t*) cbuf;
+    assert(delta_apply(dh, src, dst) == -1);
+
+    // lz: literal, overlapping run, copy from flushed pages
+    memset(cbuf, 0, sizeof(cbuf));
+    p = (uint8_t*) (lh + 1);
+    p = put_lit(p, src, 7);
+    p = put_copy(p, 400, 7);                    // repeat pattern across pages
+    p = put_lit(p, src + 100, 50);
+    p = put_copy(p, 300, 440);                  // from already written flash
+    n = 0;
+    memcpy(exp + n, src, 7); n += 7;
+    for (int i = 0; i < 400; i++, n++) {
+        exp[n] = exp[n - 7];
+    }
+    memcpy(exp + n, src + 100, 50); n += 50;
+    for (int i = 0; i < 300; i++, n++) {
+        exp[n] = exp[n - 440];
+    }
+    *lh = (lz_hdr) {
+        .magic = LZ_MAGIC,
+        .size = (p - (uint8_t*) cbuf + 3) & ~3,
+        .dstsize = n,
+    };
+    assert(lz_apply(lh, dst) == n);
+    assert(memcmp(out, exp, n) == 0);
+
+    // lz: malformed containers
+    lh->dstsize = n + 1;                        // op stream too short
+    assert(lz_apply(lh, dst) == -1);
+    lh->dstsize = n;
+    lh->size = sizeof(lz_hdr) - 4;              // size smaller than header
+    assert(lz_apply(lh, dst) == -1);
+    p = (uint8_t*) (lh + 1);
+    p = put_lit(p, src, 4);
+    p = put_copy(p, 10, 5);                     // distance beyond output
+    lh->size = (p - (uint8_t*) cbuf + 3) & ~3;
+    lh->dstsize = 14;
+    assert(lz_apply(lh, dst) == -1);
+    p = (uint8_t*) (lh + 1);
+    p = put_lit(p, src, 4);
+    p = put_copy(p, 10, 0);                     // zero distance
+    assert(lz_apply(lh, dst) == -1);
+
+    printf("delta/lz: ok\n");
+}
+
+// ------------------------------------------------
+// Incremental SHA-256 (NIST FIPS 180-2 test vectors)
+
+static void sha256_check (const char* msg, uint32_t len, uint32_t rep, uint32_t step, const char* exp) {
+    sha256_ctx ctx;
+    uint32_t hash[8];
+    char hex[65];
+    sha256_init(&ctx);
+    // feed message rep times in pieces of step bytes (0: all at once)
+    for (uint32_t i = 0; i < rep; i++) {
+        for (uint32_t off = 0; off < len; ) {
+            uint32_t n = (step == 0 || len - off < step) ? len - off : step;
+            sha256_update(&ctx, msg + off, n);
+            off += n;
+        }
+    }
+    sha256_final(&ctx, hash);
+    for (int i = 0; i < 32; i++) {
+        sprintf(hex + (i << 1), "%02x", ((uint8_t*) hash)[i]);
+    }
+    if (strcmp(hex, exp) != 0) {
+        printf("sha256: got %s, expected %s (len=%u rep=%u step=%u)\n", hex, exp, len, rep, step);
+        fflush(stdout);
+        assert(0);
+    }
+}
+
+static void test_sha256 (void) {
+    static const char* m448 = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    static const char* h448 = "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1";
+    static const char* hmio = "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0";
+    static char a1000[1000];
+
+    sha256_check("", 0, 1, 0,
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    sha256_check("abc", 3, 1, 0,
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    sha256_check("abc", 3, 1, 1,
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    // 448 bits: padding needs a second block
+    for (uint32_t step = 0; step <= 56; step++) {
+        sha256_check(m448, 56, 1, step, h448);
+    }
+    // 1,000,000 x 'a': steps that do and do not divide the block size, so
+    // updates start and end at all offsets within a block
+    memset(a1000, 'a', sizeof(a1000));
+    sha256_check(a1000, 1000, 1000, 0, hmio);
+    sha256_check(a1000, 1000, 1000, 64, hmio);
+    sha256_check(a1000, 1000, 1000, 63, hmio);
+    sha256_check(a1000, 1000, 1000, 65, hmio);
+    sha256_check(a1000, 1000, 1000, 7, hmio);
+    sha256_check(a1000, 1, 1000000, 0, hmio);
+
+    printf("sha256: ok\n");
+}
+
 int main (int argc, char** argv) {
     if (argc != 2) {
         printf("usage: %s <FILE>\n", argv[0]);
@@ -145,11 +333,6 @@ int main (int argc, char** argv) {
     uint32_t dw = (FLASH_PAGE_CT - (dnp + snp)) * (FLASH_PAGE_SZ >> 2);
     uint32_t sw = (FLASH_PAGE_CT - (snp)) * (FLASH_PAGE_SZ >> 2);
 
-    // erase session pages
-    memset(FLASH.W + mw, (fuota_flash_bitdefault) ? 0xff : 0x00, mnp * FLASH_PAGE_SZ);
-    memset(FLASH.W + dw, (fuota_flash_bitdefault) ? 0xff : 0x00, dnp * FLASH_PAGE_SZ);
-    memset(FLASH.W + sw, (fuota_flash_bitdefault) ? 0xff : 0x00, snp * FLASH_PAGE_SZ);
-
     void* matrix = word2addr(mw);
     void* data = word2addr(dw);
     void* session = word2addr(sw);
@@ -157,46 +340,108 @@ int main (int argc, char** argv) {
     printf("data addr:    %p\n", data);
     printf("session addr: %p\n", session);
 
-    fuota_init(session, matrix, data, 0x123, chunk_ct, chunk_nw);
-    fuota_session* s = session;
-
     srand(time(NULL));
 
-    uint32_t chunk_id = rand();
-    uint32_t total = 0;
-    uint32_t cc = 0;
-    while (1) {
-        uint32_t chunk[chunk_nw];
-        // skip random number of chunks (simulate packet loss)
-        chunk_id += (rand() % 10) + 1;
-        // generate a new chunk
-        fuota_gen_chunk(chunk, (uint32_t*) inbuf, chunk_id, chunk_ct, chunk_nw);
-        // process chunk
-        int rv = fuota_process(s, chunk_id, (unsigned char*) chunk);
-        assert(rv != FUOTA_ERROR);
-        total += 1;
-        // get complete count
-        uint32_t cc2;
-        int rv2 = fuota_state(s, NULL, NULL, NULL, &cc2);
-        assert(rv2 == rv);
-        printf("processed: 0x%08x: %3d/%d%s\n", chunk_id, cc2, chunk_ct,
-                (cc2 == cc) ? " *" : "");
-        cc = cc2;
-        if (rv == FUOTA_COMPLETE) {
-            assert(cc == chunk_ct);
-            printf("complete, %d chunks processed (%d useless)\n", total, total - chunk_ct);
-            break;
+    test_delta();
+    test_sha256();
+
+    // cross-check batch encoder against reference generator
+    {
+        uint32_t n = 100, cid = rand();
+        uint32_t* batch = malloc(n * chunk_nw * 4);
+        assert(batch);
+        fragenc_gen(batch, (uint32_t*) inbuf, chunk_ct, chunk_nw, cid, cid + n, 4);
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t chunk[chunk_nw];
+            fuota_gen_chunk(chunk, (uint32_t*) inbuf, cid + i, chunk_ct, chunk_nw);
+            assert(memcmp(chunk, batch + (i * chunk_nw), chunk_nw * 4) == 0);
         }
-        assert(rv == FUOTA_MORE);
-        assert(cc != chunk_ct);
+        free(batch);
+        printf("batch encoder: %d chunks verified\n", n);
     }
 
-    void* outbuf = fuota_unpack(s);
-    assert(outbuf);
-    assert(outbuf == data);
+    static const struct {
+        int algo;
+        const char* name;
+    } algos[] = {
+        { FUOTA_ALGO_TRACKNET, "tracknet" },
+        { FUOTA_ALGO_STDFEC,   "stdfec" },
+    };
+    uint32_t totals[2];
+    double times[2];
+    unsigned int seed = rand();
+
+    for (int a = 0; a < 2; a++) {
+        // erase session pages
+        memset(FLASH.W + mw, (fuota_flash_bitdefault) ? 0xff : 0x00, mnp * FLASH_PAGE_SZ);
+        memset(FLASH.W + dw, (fuota_flash_bitdefault) ? 0xff : 0x00, dnp * FLASH_PAGE_SZ);
+        memset(FLASH.W + sw, (fuota_flash_bitdefault) ? 0xff : 0x00, snp * FLASH_PAGE_SZ);
+
+        fuota_init_ex(session, matrix, data, 0x123, chunk_ct, chunk_nw, algos[a].algo);
+        fuota_session* s = session;
+
+        // same packet loss pattern for both algorithms
+        srand(seed);
+
+        uint32_t chunk_id = rand();
+        if (algos[a].algo == FUOTA_ALGO_STDFEC) {
+            chunk_id = 0; // fragment indices start at 1 with the uncoded chunks
+        }
+        uint32_t total = 0;
+        uint32_t cc = 0;
+        clock_t t = 0;
+        while (1) {
+            uint32_t chunk[chunk_nw];
+            // skip random number of chunks (simulate packet loss)
+            chunk_id += (rand() % 10) + 1;
+            // generate a new chunk
+            fuota_gen_chunk_ex(chunk, (uint32_t*) inbuf, chunk_id, chunk_ct, chunk_nw, algos[a].algo);
+            // process chunk
+            clock_t t0 = clock();
+            int rv = fuota_process(s, chunk_id, (unsigned char*) chunk);
+            t += clock() - t0;
+            assert(rv != FUOTA_ERROR);
+            total += 1;
+            // get complete count
+            uint32_t cc2;
+            int rv2 = fuota_state(s, NULL, NULL, NULL, &cc2);
+            assert(rv2 == rv);
+            printf("processed: 0x%08x: %3d/%d%s\n", chunk_id, cc2, chunk_ct,
+                    (cc2 == cc) ? " *" : "");
+            cc = cc2;
+            if (rv == FUOTA_COMPLETE) {
+                assert(cc == chunk_ct);
+                printf("complete, %d chunks processed (%d useless)\n", total, total - chunk_ct);
+                break;
+            }
+            assert(rv == FUOTA_MORE);
+            assert(cc != chunk_ct);
+        }
+
+        clock_t t0 = clock();
+        void* outbuf = fuota_unpack(s);
+        t += clock() - t0;
+        assert(outbuf);
+        assert(outbuf == data);
+
+        int diff = memcmp(inbuf, FLASH.W + addr2word(outbuf), chunk_ct * chunk_nw * 4);
+        assert(!diff);
 
-    int diff = memcmp(inbuf, FLASH.W + addr2word(outbuf), chunk_ct * chunk_nw * 4);
-    assert(!diff);
+        // digest is write-once
+        uint32_t dg[8] = { 1, 2, 3, 4, 5, 6, 7, 8 }, dg2[8];
+        assert(!fuota_get_digest(s, dg2));
+        fuota_set_digest(s, dg);
+        assert(fuota_get_digest(s, dg2) && memcmp(dg, dg2, sizeof(dg)) == 0);
+
+        totals[a] = total;
+        times[a] = (double) t / CLOCKS_PER_SEC;
+    }
+
+    printf("%-10s %8s %8s %10s\n", "algorithm", "chunks", "extra", "decode");
+    for (int a = 0; a < 2; a++) {
+        printf("%-10s %8d %8d %8.3fs\n", algos[a].name, totals[a],
+                totals[a] - chunk_ct, times[a]);
+    }
 
     printf("all done!\n");
 
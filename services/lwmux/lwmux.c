@@ -195,15 +195,23 @@ static void tx_opportunity (osjob_t* j) {
         txinfo.dlen = LMIC_maxAppPayload();
         if (job->txfunc(&txinfo)) {
             ASSERT((unsigned int) txinfo.dlen < MAX_LEN_PAYLOAD);
+            const u1_t* buf = NULL;
+            // refreshed by MAC right before frame build (channel, LBT and DR final)
+            LMIC.pendTxJit = txinfo.jit_cb;
             if (txinfo.data != LMIC.pendTxData) {
-                os_copyMem(LMIC.pendTxData, txinfo.data, txinfo.dlen);
+                if (txinfo.nocopy && !txinfo.jit_cb) {
+                    // MAC copies payload straight from job buffer into frame
+                    buf = txinfo.data;
+                } else {
+                    os_copyMem(LMIC.pendTxData, txinfo.data, txinfo.dlen);
+                }
             }
             LMIC.pendTxConf = txinfo.confirmed;
             LMIC.pendTxPort = txinfo.port;
             LMIC.pendTxLen = txinfo.dlen;
             state.flags |= FLAG_BUSY;
             state.completefunc = txinfo.txcomplete;
-            LMIC_setTxData();
+            LMIC_setTxDataBuf(buf);
             return;
         }
     }
@@ -433,7 +441,8 @@ DECL_ON_LMIC_EVENT {
     if (e == EV_TXCOMPLETE || e == EV_RXCOMPLETE) {
         if ((LMIC.txrxFlags & TXRX_PORT) && LMIC.frame[LMIC.dataBeg-1]) {
             SVCHOOK_lwm_downlink(LMIC.frame[LMIC.dataBeg-1],
-                                 LMIC.frame + LMIC.dataBeg, LMIC.dataLen, LMIC.txrxFlags & LWM_FLAG_MASK);
+                                 LMIC.frame + LMIC.dataBeg, LMIC.dataLen, (LMIC.txrxFlags & LWM_FLAG_MASK)
+                                 | ((LMIC.dnMcgrp >= 0) ? LWM_FLAG_MCAST : 0));
         }
     }
 
@@ -477,5 +486,5 @@ void lwm_process_dl (lwm_downlink dlfunc) {
     dlfunc( (LMIC.txrxFlags & TXRX_PORT) ? LMIC.frame[LMIC.dataBeg-1] : -1,
             (LMIC.txrxFlags & TXRX_PORT) ? LMIC.frame+LMIC.dataBeg : NULL,
             (LMIC.txrxFlags & TXRX_PORT) ? LMIC.dataLen :  0,
-             LMIC.txrxFlags);
+             LMIC.txrxFlags | ((LMIC.dnMcgrp >= 0) ? LWM_FLAG_MCAST : 0));
 }
@@ -16,8 +16,9 @@ typedef struct {
     int dlen;
     int port;
     int confirmed;
+    bool nocopy;        // data is not copied - it must stay unchanged until txcomplete
     lwm_complete txcomplete;
-    lwm_jit_cb jit_cb;
+    lwm_jit_cb jit_cb;  // called at TX time with queued data and max length at current DR, returns new dlen
 } lwm_txinfo;
 
 typedef bool (*lwm_tx) (lwm_txinfo*);
@@ -63,6 +64,7 @@ enum {
     LWM_FLAG_DNW1       = TXRX_DNW1,
     LWM_FLAG_DNW2       = TXRX_DNW2,
     LWM_FLAG_PING       = TXRX_PING,
+    LWM_FLAG_MCAST      = 0x100,    // received via multicast group
 };
 #define LWM_FLAG_MASK (LWM_FLAG_ACK | LWM_FLAG_NAK | LWM_FLAG_DNW1 | LWM_FLAG_DNW2 | LWM_FLAG_PING)
 typedef void (*lwm_downlink) (int port, unsigned char* data, int dlen, unsigned int flags);
@@ -109,5 +109,14 @@ static void update_rtstats (void) {
     pwrman_consume(PWRMAN_C_SLEEP, stats.sleep_ticks[HAL_SLEEP_S0], BRD_PWR_S0_UA);
     pwrman_consume(PWRMAN_C_SLEEP, stats.sleep_ticks[HAL_SLEEP_S1], BRD_PWR_S1_UA);
     pwrman_consume(PWRMAN_C_SLEEP, stats.sleep_ticks[HAL_SLEEP_S2], BRD_PWR_S2_UA);
+
+    // data EEPROM programming current (on top of MCU run current)
+    eeprom_rtstats ee;
+    eeprom_rtstats_collect(&ee);
+    for( int i = 0; i < EEPROM_R_CNT; i++ ) {
+        // word program takes 1.6ms, plus another 1.6ms if it needs an erase
+        uint32_t ticks = (ee.writes[i] + ee.erases[i]) * us2osticks(1600);
+        pwrman_consume(PWRMAN_C_RUN, ticks, BRD_PWR_EE_UA);
+    }
 #endif
 }
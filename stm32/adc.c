@@ -7,14 +7,32 @@
 #include "lmic.h"
 #include "peripherals.h"
 
+#if defined(STM32L0)
+static struct {
+    unsigned int calibrated;    // calibration factor is valid
+    unsigned int calfact;       // calibration factor (kept across power-down)
+    osjob_t* job;               // pending asynchronous conversion (NULL: none)
+    osjobcb_t cb;
+    int* pstatus;
+} adc;
+#endif
+
 static void adc_on (void) {
 #if defined(STM32L0)
+    RCC->APB1ENR |= RCC_APB1ENR_PWREN;          // Vrefint may still start up after
+    while( (PWR->CSR & PWR_CSR_VREFINTRDYF) == 0 ); // fast wake-up from Stop mode
+    RCC->APB1ENR &= ~RCC_APB1ENR_PWREN;
     RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;         // enable peripheral clock
-    ADC1->CR |= ADC_CR_ADCAL;                   // start calibration
-    while( (ADC1->CR & ADC_CR_ADCAL) != 0 );    // wait for it
+    if( !adc.calibrated ) {
+        ADC1->CR |= ADC_CR_ADCAL;               // start calibration
+        while( (ADC1->CR & ADC_CR_ADCAL) != 0 ); // wait for it
+        adc.calfact = ADC1->CALFACT;            // remember calibration factor
+        adc.calibrated = 1;
+    }
     ADC1->ISR = ADC_ISR_ADRDY;                  // clear ready bit (rc_w1)
     ADC1->CR |= ADC_CR_ADEN;                    // switch on the ADC
     while( (ADC1->ISR & ADC_ISR_ADRDY) == 0 );  // wait until ADC is ready
+    ADC1->CALFACT = adc.calfact;                // restore calibration factor (lost with regulator)
 #elif defined(STM32L1)
     RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;         // make sure the ADC is clocked
     ADC1->CR2 |= ADC_CR2_ADON;                  // switch on the ADC
@@ -32,29 +50,110 @@ static void adc_off (void) {
 #endif
 }
 
-unsigned int adc_read (unsigned int chnl, unsigned int rate) {
-    adc_on();
 #if defined(STM32L0)
-    if( chnl == VREFINT_ADC_CH ) {
+// select channels (scanned in ascending order), sample rate and oversampling (2^ovs samples, averaged)
+static void adc_setup (unsigned int chmask, unsigned int rate, unsigned int ovs) {
+    if( chmask & (1 << VREFINT_ADC_CH) ) {
         ADC->CCR |= ADC_CCR_VREFEN;             // internal voltage reference on channel 17
-    } else if( chnl == TEMPINT_ADC_CH ) {
+    }
+    if( chmask & (1 << TEMPINT_ADC_CH) ) {
         ADC->CCR |= ADC_CCR_TSEN;               // internal temperature on channel 18
     }
-    ADC1->CHSELR = (1 << chnl);                 // select channel
+    ADC1->CHSELR = chmask;                      // select channels
     ADC1->SMPR = rate & 0x7;                    // sample rate
+    ADC1->CFGR2 = (ADC1->CFGR2 & ADC_CFGR2_CKMODE) | ((ovs == 0) ? 0 :
+            (((ovs - 1) << 2) & ADC_CFGR2_OVSR) | ((ovs << 5) & ADC_CFGR2_OVSS) | ADC_CFGR2_OVSE);
+}
+
+static void adc_cleanup (void) {
+    ADC->CCR &= ~(ADC_CCR_VREFEN | ADC_CCR_TSEN);
+    ADC1->CFGR1 = 0;
+    ADC1->CFGR2 &= ADC_CFGR2_CKMODE;
+}
+#endif
+
+unsigned int adc_read (unsigned int chnl, unsigned int rate) {
+#if defined(STM32L0)
+    ASSERT(adc.job == NULL);                    // not while a scan is pending (shares ADC and DMA)
+#endif
+    adc_on();
+#if defined(STM32L0)
+    ADC1->CFGR1 = 0;                            // single conversion, no DMA
+    adc_setup(1 << chnl, rate, 0);
     ADC1->CR |= ADC_CR_ADSTART;                 // start conversion
     while( (ADC1->ISR & ADC_ISR_EOC) == 0 );    // wait for it
-    if( chnl == VREFINT_ADC_CH ) {
-        ADC->CCR &= ~ADC_CCR_VREFEN;
-    } else if( chnl == TEMPINT_ADC_CH ) {
-        ADC->CCR &= ~ADC_CCR_TSEN;
-    }
+    u2_t v = ADC1->DR;
+    adc_cleanup();
 #elif defined(STM32L1)
     ADC1->SQR5 = chnl;                          // select the channel for the 1st conversion
     ADC1->CR2 |= ADC_CR2_SWSTART;               // start the conversion
     while( (ADC1->SR & ADC_SR_EOC) == 0 );      // wait for it
-#endif
     u2_t v = ADC1->DR;
+#endif
     adc_off();
     return v;
 }
+
+#if defined(STM32L0)
+static void adc_stop (int status) {
+    // stop conversion
+    if( ADC1->CR & ADC_CR_ADSTART ) {
+        ADC1->CR |= ADC_CR_ADSTP;
+        while( (ADC1->CR & ADC_CR_ADSTP) != 0 );
+    }
+    // disable DMA channel and interrupt (DMA clock stays on, it may be used by other drivers)
+    NVIC_DisableIRQ(DMA1_Channel1_IRQn);
+    DMA1_Channel1->CCR = 0;
+    DMA1->IFCR = DMA_IFCR_CGIF1;
+    adc_cleanup();
+    adc_off();
+    // schedule callback
+    *adc.pstatus = status;
+    os_setCallback(adc.job, adc.cb);
+    adc.job = NULL;
+    // re-enable sleep
+    hal_clearMaxSleep(HAL_SLEEP_S0);
+}
+
+void adc_dma_irq (void) {
+    unsigned int isr = DMA1->ISR;
+    if( isr & DMA_ISR_TEIF1 ) {
+        adc_stop(ADC_ERROR);
+    } else if( isr & DMA_ISR_TCIF1 ) {
+        adc_stop(ADC_OK);
+    }
+}
+
+void adc_read_ex (unsigned int chmask, unsigned int rate, unsigned int ovs, u2_t* buf,
+        osjob_t* job, osjobcb_t cb, int* pstatus) {
+    ASSERT(adc.job == NULL && chmask != 0 && ovs <= 8);
+    adc.job = job;
+    adc.cb = cb;
+    adc.pstatus = pstatus;
+    *pstatus = ADC_BUSY;
+    // ADC (HSI16) and DMA keep running in sleep mode, but not in S1/S2
+    hal_setMaxSleep(HAL_SLEEP_S0);
+    adc_on();
+    // DMA channel 1: ADC1->DR to buf, one half-word per selected channel
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    DMA1_CSELR->CSELR &= ~DMA_CSELR_C1S;        // channel 1 request 0 (ADC)
+    DMA1_Channel1->CPAR = (uint32_t) &ADC1->DR;
+    DMA1_Channel1->CMAR = (uint32_t) buf;
+    DMA1_Channel1->CNDTR = __builtin_popcount(chmask);
+    DMA1_Channel1->CCR = DMA_CCR_MINC | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0
+        | DMA_CCR_TCIE | DMA_CCR_TEIE | DMA_CCR_EN;
+    NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+    // scan selected channels once, transfer results by DMA
+    ADC1->CFGR1 = ADC_CFGR1_DMAEN;
+    adc_setup(chmask, rate, ovs);
+    ADC1->CR |= ADC_CR_ADSTART;
+}
+
+void adc_abort (void) {
+    hal_disableIRQs();
+    if( adc.job ) {
+        adc_stop(ADC_ABORT);
+    }
+    hal_enableIRQs();
+}
+#endif
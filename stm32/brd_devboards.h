@@ -85,6 +85,10 @@
 #define BRD_PWR_S2_UA  5
 #endif
 
+#ifndef BRD_PWR_EE_UA
+#define BRD_PWR_EE_UA  500
+#endif
+
 
 // -------------------------------------------
 #elif defined(CFG_b_l072Z_lrwan1_board)
@@ -146,6 +150,10 @@
 #define BRD_PWR_S2_UA  5
 #endif
 
+#ifndef BRD_PWR_EE_UA
+#define BRD_PWR_EE_UA  500
+#endif
+
 // brown-out
 #define BRD_borlevel   9 // RM0376, pg 116: BOR level 2, around 2.0 V
 
@@ -6,43 +6,116 @@
 
 #include "peripherals.h"
 
-// write 32-bit word to EEPROM memory
-void eeprom_write (void* dest, unsigned int val) {
-    u4_t* addr = dest;
-    // check previous value
-    if( *addr != val ) {
-        // unlock data eeprom memory and registers
-        FLASH->PEKEYR = 0x89ABCDEF; // FLASH_PEKEY1
-        FLASH->PEKEYR = 0x02030405; // FLASH_PEKEY2
+#ifdef CFG_rtstats
+static eeprom_rtstats stats;
+
+static int region (u4_t* addr) {
+    u4_t a = (u4_t) addr;
+    return (a < STACKDATA_BASE) ? EEPROM_R_BOOT :
+        (a < PERSODATA_BASE) ? EEPROM_R_STACK :
+        (a < APPDATA_BASE) ? EEPROM_R_PERSO : EEPROM_R_APP;
+}
 
-        // only auto-erase if neccessary (when content is non-zero)
+void eeprom_rtstats_collect (eeprom_rtstats* s) {
+    hal_disableIRQs();
+    *s = stats;
+    os_clearMem(&stats, sizeof(stats));
+    hal_enableIRQs();
+}
+#endif
+
+static void unlock (void) {
+    // unlock data eeprom memory and registers
+    FLASH->PEKEYR = 0x89ABCDEF; // FLASH_PEKEY1
+    FLASH->PEKEYR = 0x02030405; // FLASH_PEKEY2
+
+    // only auto-erase if neccessary (when content is non-zero)
 #if defined(STM32L0)
-        FLASH->PECR &= ~FLASH_PECR_FIX; // clear FIX
+    FLASH->PECR &= ~FLASH_PECR_FIX; // clear FIX
 #elif defined(STM32L1)
-        FLASH->PECR &= ~FLASH_PECR_FTDW; // clear FTDW
+    FLASH->PECR &= ~FLASH_PECR_FTDW; // clear FTDW
+#endif
+
+    // end of programming raises pending (masked) FLASH interrupt, which sets the event flag
+    FLASH->SR = FLASH_SR_EOP;
+    NVIC_ClearPendingIRQ(FLASH_IRQn);
+    FLASH->PECR |= FLASH_PECR_EOPIE;
+    SCB->SCR |= SCB_SCR_SEVONPEND_Msk;
+}
+
+static void lock (void) {
+    SCB->SCR &= ~SCB_SCR_SEVONPEND_Msk;
+    FLASH->PECR &= ~FLASH_PECR_EOPIE;
+
+    // lock data eeprom memory and registers
+    FLASH->PECR |= FLASH_PECR_PELOCK;
+}
+
+// program word (data eeprom must be unlocked)
+static void program (u4_t* addr, u4_t val) {
+#ifdef CFG_rtstats
+    int r = region(addr);
+    stats.writes[r] += 1;
+    if( *addr != 0 ) {
+        stats.erases[r] += 1;
+    }
 #endif
 
-        // write value
-        *addr = val;
+    // write value
+    *addr = val;
 
-        // check for end of programming
-        while( FLASH->SR & FLASH_SR_BSY ); // loop while busy
+    // sleep until end of programming (word write takes up to 3.2ms)
+    while( FLASH->SR & FLASH_SR_BSY ) { // loop while busy
+        __WFE();
+    }
+    FLASH->SR = FLASH_SR_EOP;
+    NVIC_ClearPendingIRQ(FLASH_IRQn);
 
-        // lock data eeprom memory and registers
-        FLASH->PECR |= FLASH_PECR_PELOCK;
+    // verify value
+    ASSERT( *((volatile u4_t*) addr) == val );
+}
 
-        // verify value
-        ASSERT( *((volatile u4_t*) addr) == val );
+// write 32-bit word to EEPROM memory
+void eeprom_write (void* dest, unsigned int val) {
+    u4_t* addr = dest;
+    // check previous value
+    if( *addr != val ) {
+        unlock();
+        program(addr, val);
+        lock();
+    }
+#ifdef CFG_rtstats
+    else {
+        stats.skips[region(addr)] += 1;
     }
+#endif
 }
 
+// copy words to EEPROM memory (unlocked once for the whole burst, unchanged words are skipped)
 void eeprom_copy (void* dest, const void* src, int len) {
     ASSERT( (((u4_t) dest | (u4_t) src | len) & 3) == 0 );
     u4_t* d = (u4_t*) dest;
     u4_t* s = (u4_t*) src;
     len >>= 2;
 
+    int locked = 1;
     while( len-- ) {
-        eeprom_write(d++, *s++);
+        if( *d != *s ) {
+            if( locked ) {
+                unlock();
+                locked = 0;
+            }
+            program(d, *s);
+        }
+#ifdef CFG_rtstats
+        else {
+            stats.skips[region(d)] += 1;
+        }
+#endif
+        d++;
+        s++;
+    }
+    if( !locked ) {
+        lock();
     }
 }
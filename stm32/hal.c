@@ -32,9 +32,17 @@ static struct {
     struct {
         uint32_t run;                   // ticks running
         uint32_t sleep[HAL_SLEEP_CNT];  // ticks sleeping
+        uint32_t diostamps;             // DIO wake-ups also captured by TIM22
+        uint32_t diostamperr;           // max. deviation of wake-up time from capture
     } rtstats;
 #endif
     u1_t maxsleep[HAL_SLEEP_CNT-1]; // deep sleep restrictions
+    u1_t wakedio;                   // last wake-up from S1 was caused by radio DIO
+    u4_t wakeup;                    // time of that wake-up
+    struct {
+        u4_t time;
+        void (*func) (void);
+    } tcall;                        // pending timed call (see hal_timedCall)
     u1_t battlevel;
     boot_boottab* boottab;
 } HAL;
@@ -205,7 +213,8 @@ u1_t hal_spi (u1_t out) {
 // - TIM22 also uses the LSE as clock source
 // - TIM22 can be correlated to LPTIM1
 // - TIM22 is used as the on-time wake-up source for S0/S1
-// - TIM22 can be used to timestamp external events, e.g. DIO0 from the radio
+// - TIM22 channel 2 also triggers hal_timedCall() while running
+// - TIM22 channel 1 timestamps radio DIO edges (input capture, see DIO_UPDATE)
 //
 //
 //    R0 ──────┬────────┐
@@ -540,6 +549,8 @@ static void clock_sleep (int stype) {
             | PWR_CR_ULP         // Ultra LP sleep (no Vref, thus no BOR, PVD, temp sensor)
           /*| PWR_CR_DSEEKOFF */ // Do not power up NVM on wake up   FIXME doesn't work as advertized ?!?
             ;
+        // do not wait for Vrefint on wake-up (ADC waits for it)
+        pwr_cr |= PWR_CR_FWU;
         // set sleep mode to deep (maps to Stop mode)
         SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
     } else {
@@ -554,18 +565,67 @@ static void clock_sleep (int stype) {
     RCC->APB1ENR &= ~RCC_APB1ENR_PWREN;
 }
 
+// EXTI lines of radio DIOs
+#define DIO_EXTI_MASK (0 DIO_EXTI(0) DIO_EXTI(1) DIO_EXTI(2) DIO_EXTI(3))
+#define DIO_EXTI(dio) DIO_EXTI_ ## dio
+#ifdef GPIO_DIO0
+#define DIO_EXTI_0 | (1 << BRD_PIN(GPIO_DIO0))
+#else
+#define DIO_EXTI_0
+#endif
+#ifdef GPIO_DIO1
+#define DIO_EXTI_1 | (1 << BRD_PIN(GPIO_DIO1))
+#else
+#define DIO_EXTI_1
+#endif
+#ifdef GPIO_DIO2
+#define DIO_EXTI_2 | (1 << BRD_PIN(GPIO_DIO2))
+#else
+#define DIO_EXTI_2
+#endif
+#ifdef GPIO_DIO3
+#define DIO_EXTI_3 | (1 << BRD_PIN(GPIO_DIO3))
+#else
+#define DIO_EXTI_3
+#endif
+
+// Remember wake-up time if a radio DIO edge ended S1 sleep. The EXTI handler
+// only runs after the clock has been restored, so it uses this time as IRQ
+// timestamp. Must be called right after wake-up, while still running on the
+// 4MHz MSI (LPTIM1 cannot be read reliably on the 65kHz MSI of S2, and
+// reading it after clock_run() would include the clock restore time).
+static u4_t wake_stamp (u4_t hticks) {
+    if( (EXTI->PR & DIO_EXTI_MASK) != 0 ) {
+        u4_t cnt = time_cnt_unsafe();
+        u4_t ht = hticks;
+        if( (LPTIM1->ISR & LPTIM_ISR_ARRM) != 0 ) {
+            // include pending overflow in evaluation
+            cnt = time_cnt_unsafe();
+            ht++;
+        }
+        HAL.wakeup = (ht << 16) | cnt;
+        HAL.wakedio = 1;
+    }
+    return hticks;
+}
+
 __fastcode static u4_t sleep2 (u4_t hticks, u4_t htt, u4_t ltt) {
     clock_sleep(HAL_SLEEP_S2);
     flash_off();
     hticks = sleep_htt(HAL.ticks, htt);
     flash_on();
     clock_run();
+    if( (EXTI->PR & DIO_EXTI_MASK) != 0 ) {
+        // TIM22 is not clocked in Stop mode, drop capture of late edge
+        (void) TIM22->CCR1;
+    }
     return hticks;
 }
 
 static u4_t sleep1 (u4_t hticks, u4_t htt, u4_t ltt) {
     clock_sleep(HAL_SLEEP_S1);
     hticks = sleep_htt_ltt(HAL.ticks, htt, ltt);
+    hticks = wake_stamp(hticks);
     clock_run();
     return hticks;
 }
@@ -611,6 +671,19 @@ static u8_t hal_xticks_unsafe (void) {
     return (xt << 16) | cnt;
 }
 
+// read current time and TIM22 counter at the same tick
+static u4_t ticks_tim22_unsafe (u2_t* tcnt) {
+    u4_t t0, t1 = hal_ticks_unsafe();
+    u2_t tx;
+    do {
+        t0 = t1;
+        tx = TIM22->CNT;
+        t1 = hal_ticks_unsafe();
+    } while( t1 != t0 );
+    *tcnt = tx;
+    return t1;
+}
+
 u8_t hal_xticks () {
     hal_disableIRQs();
     u8_t xt = hal_xticks_unsafe();
@@ -622,6 +695,66 @@ u4_t hal_ticks () {
     return hal_xticks();
 }
 
+// Timed call - runs with interrupts disabled either from hal_sleep, which
+// wakes up for it like for an exact job, or from the TIM22 CC2 interrupt if
+// the CPU is busy at that time. CC2 is shared with sleep_htt_ltt, so it is
+// disarmed while sleeping.
+static void tcall_disarm (void) {
+    TIM22->CCER &= ~TIM_CCER_CC2E;
+    TIM22->DIER &= ~TIM_DIER_CC2IE;
+    TIM22->SR = ~TIM_SR_CC2IF;
+    NVIC->ICPR[0] = (1 << TIM22_IRQn);
+}
+
+static void tcall_arm (void) {
+    u2_t tx;
+    s4_t d = (s4_t) HAL.tcall.time - (s4_t) ticks_tim22_unsafe(&tx);
+    if( d < 1 ) {
+        d = 1;
+    } else if( d > 0xffff ) {
+        d = 0xffff; // re-armed on early match
+    }
+    TIM22->CCR2 = (tx + d) & 0xffff;
+    TIM22->SR = ~TIM_SR_CC2IF;
+    TIM22->DIER |= TIM_DIER_CC2IE;
+    TIM22->CCER |= TIM_CCER_CC2E;
+}
+
+static void tcall_run (void) {
+    void (*func) (void) = HAL.tcall.func;
+    HAL.tcall.func = NULL;
+    tcall_disarm();
+    func();
+}
+
+static void tcall_irq (void) {
+    if( (TIM22->SR & TIM_SR_CC2IF) != 0 ) {
+        tcall_disarm();
+        if( HAL.tcall.func ) {
+            if( (s4_t) HAL.tcall.time - (s4_t) hal_ticks_unsafe() <= 0 ) {
+                tcall_run();
+            } else {
+                tcall_arm();
+            }
+        }
+    }
+}
+
+void hal_timedCall (u4_t time, void (*func) (void)) {
+    hal_disableIRQs();
+    tcall_disarm();
+    HAL.tcall.time = time;
+    HAL.tcall.func = func;
+    if( func ) {
+        if( (s4_t) time - (s4_t) hal_ticks_unsafe() <= 0 ) {
+            tcall_run();
+        } else {
+            tcall_arm();
+        }
+    }
+    hal_enableIRQs();
+}
+
 // NOTE: interrupts are already be disabled when this HAL function is called!
 u1_t hal_sleep (u1_t type, u4_t targettime) {
     static const u8_t S_TH[] = {
@@ -629,6 +762,10 @@ u1_t hal_sleep (u1_t type, u4_t targettime) {
     };
 
     u8_t xnow = hal_xticks_unsafe();
+    if( HAL.tcall.func && ((s4_t) HAL.tcall.time - (s4_t) xnow) <= 0 ) {
+        tcall_run();
+        return 1; // not a job
+    }
     s4_t dt;
     if( type == HAL_SLEEP_FOREVER ) {
         dt = sec2osticks(12*60*60); // 12 h
@@ -638,6 +775,13 @@ u1_t hal_sleep (u1_t type, u4_t targettime) {
     if( dt <= 0 ) {
         return 0; // it's time now
     }
+    if( (EXTI->PR & DIO_EXTI_MASK) != 0 ) {
+        return 1; // radio IRQ pending - handle it first (keeps its timestamp)
+    }
+    if( HAL.tcall.func && ((s4_t) HAL.tcall.time - (s4_t) xnow) < dt ) {
+        // wake up exactly for timed call
+        dt = (s4_t) HAL.tcall.time - (s4_t) xnow;
+    }
 
     // select sleep type
     int stype;
@@ -663,7 +807,14 @@ u1_t hal_sleep (u1_t type, u4_t targettime) {
 #endif
 
     xnow += (dt - S_TH[stype]);
+    HAL.wakedio = 0;
+    if( HAL.tcall.func ) {
+        tcall_disarm();
+    }
     sleep(stype, xnow >> 16, xnow & 0xffff);
+    if( HAL.tcall.func ) {
+        tcall_arm();
+    }
 
 #ifdef CFG_rtstats
     ostime_t t2 = hal_ticks_unsafe();
@@ -834,43 +985,70 @@ bool hal_dio2_controls_rxtx (void) {
 }
 #endif // defined(BRD_sx1261_radio) || defined(BRD_sx1262_radio)
 
-#define DIO_UPDATE(dio,mask,time) do { \
+// Radio DIOs on a TIM22 capture pin (BRD_GPIO_CHAN) are timestamped in
+// hardware. Only channel 1 is available, channel 2 is used by sleep_htt_ltt.
+// TIM22 counts the same LSE clock as LPTIM1, so the ticks elapsed since the
+// capture are subtracted from the current time. The resolution therefore is
+// one tick, but the stamp is free of IRQ and wake-up latency. TIM22 keeps
+// running in S0 and S1, so the capture is used for edges that woke us up,
+// too (sleep2 drops it, see there). The wake-up stamp is then only compared
+// against it (see dio_stamp_stats).
+#define DIO_UPDATE(dio,mask,time,now,tcnt) do { \
     if( (EXTI->PR & (1 << BRD_PIN(GPIO_DIO ## dio))) ) { \
         EXTI->PR = (1 << BRD_PIN(GPIO_DIO ## dio)); \
         *(mask) |= (1 << dio); \
-        /* if( BRD_GPIO_GET_CHAN(GPIO_DIO ## dio) ) { \
-            unsigned int ch = BRD_GPIO_GET_CHAN(GPIO_DIO ## dio) - 1; \
-            ASSERT(TIMx->SR & (TIM_SR_CC1IF << ch)); \
-            s2_t ct = (&(TIMx->CCR1))[ch]; \
-            *(time) += (ct - (s2_t) *(time)); \
-        } */ \
+        if( BRD_GPIO_GET_CHAN(GPIO_DIO ## dio) && (TIM22->SR & TIM_SR_CC1IF) ) { \
+            u2_t ct = TIM22->CCR1; /* clears CC1IF */ \
+            *(time) = (now) - (u2_t) ((tcnt) - ct); \
+            if( HAL.wakedio ) { \
+                dio_stamp_stats(*(time)); \
+            } \
+        } \
     } \
 } while( 0 )
 
+// measure accuracy of wake-up timestamps against the TIM22 capture
+static void dio_stamp_stats (u4_t t) {
+#ifdef CFG_rtstats
+    s4_t d = (s4_t) (HAL.wakeup - t);
+    if( d < 0 ) {
+        d = -d;
+    }
+    HAL.rtstats.diostamps += 1;
+    if( (u4_t) d > HAL.rtstats.diostamperr ) {
+        HAL.rtstats.diostamperr = d;
+    }
+#endif
+}
+
 // generic EXTI IRQ handler for all channels
 static void EXTI_IRQHandler () {
-    u4_t now = hal_ticks_unsafe();
+    u2_t tcnt;
+    u4_t now = ticks_tim22_unsafe(&tcnt);
+    // if DIO woke us from S1, use wake-up time unless the edge was captured
+    u4_t stamp = HAL.wakedio ? HAL.wakeup : now;
     u1_t diomask = 0;
 #ifdef GPIO_DIO0
     // DIO 0
-    DIO_UPDATE(0, &diomask, &now);
+    DIO_UPDATE(0, &diomask, &stamp, now, tcnt);
 #endif
 #ifdef GPIO_DIO1
     // DIO 1
-    DIO_UPDATE(1, &diomask, &now);
+    DIO_UPDATE(1, &diomask, &stamp, now, tcnt);
 #endif
 #ifdef GPIO_DIO2
     // DIO 2
-    DIO_UPDATE(2, &diomask, &now);
+    DIO_UPDATE(2, &diomask, &stamp, now, tcnt);
 #endif
 #ifdef GPIO_DIO3
     // DIO 3
-    DIO_UPDATE(3, &diomask, &now);
+    DIO_UPDATE(3, &diomask, &stamp, now, tcnt);
 #endif
+    HAL.wakedio = 0;
 
     if(diomask) {
         // invoke radio handler (on IRQ)
-        radio_irq_handler(diomask, now);
+        radio_irq_handler(diomask, stamp);
     }
 
 #ifdef CFG_EXTI_IRQ_HANDLER
@@ -884,26 +1062,23 @@ static void EXTI_IRQHandler () {
 
 static void dio_config (int mask, int pin, int gpio) {
     if( mask & pin ) {
-#if 0
         if( BRD_GPIO_GET_CHAN(gpio) ) {
-            unsigned int ch = BRD_GPIO_GET_CHAN(gpio) - 1;
-            TIMx->CCMR1 |= (1 << (ch << 3));
-            TIMx->SR = ~(TIM_SR_CC1IF << ch);
-            TIMx->CCER |= (TIM_CCER_CC1E << (ch << 2));
+            ASSERT(BRD_GPIO_GET_CHAN(gpio) == 1);
+            // input capture IC1 on TI1, rising edge, no IRQ (flag polled by EXTI handler)
+            TIM22->CCER &= ~TIM_CCER_CC1E;
+            TIM22->CCMR1 = (TIM22->CCMR1 & ~(TIM_CCMR1_CC1S | TIM_CCMR1_IC1F | TIM_CCMR1_IC1PSC)) | TIM_CCMR1_CC1S_0;
+            (void) TIM22->CCR1; // clear CC1IF
+            TIM22->SR = ~TIM_SR_CC1OF;
+            TIM22->CCER |= TIM_CCER_CC1E;
             CFG_PIN_AF(gpio, 0);
-        } else
-#endif
-        {
+        } else {
             CFG_PIN(gpio, GPIOCFG_MODE_INP);
         }
         IRQ_PIN_SET(gpio, 1);
     } else {
-#if 0
         if( BRD_GPIO_GET_CHAN(gpio) ) {
-            unsigned int ch = BRD_GPIO_GET_CHAN(gpio) - 1;
-            TIMx->CCER &= ~(TIM_CCER_CC1E << (ch << 2));
+            TIM22->CCER &= ~TIM_CCER_CC1E;
         }
-#endif
         IRQ_PIN_SET(gpio, 0);
         CFG_PIN_DEFAULT(gpio);
         EXTI->PR = (1 << BRD_PIN(gpio)); // clear irq
@@ -911,7 +1086,7 @@ static void dio_config (int mask, int pin, int gpio) {
 }
 
 void hal_irqmask_set (int mask) {
-    static int prevmask = 0;
+    static int prevlevel = -1;
 
 #ifdef GPIO_DIO0
     dio_config(mask, HAL_IRQMASK_DIO0, GPIO_DIO0);
@@ -926,16 +1101,21 @@ void hal_irqmask_set (int mask) {
     dio_config(mask, HAL_IRQMASK_DIO3, GPIO_DIO3);
 #endif
 
-    mask = (mask != 0);
-    if (prevmask != mask) {
-        // prevent sleep if we are waiting for radio interrupts
-        // TODO - evaluate if that is the correct thing to do
-        if (mask) {
-            hal_setMaxSleep(HAL_SLEEP_S0);
-        } else {
-            hal_clearMaxSleep(HAL_SLEEP_S0);
+    // DIO edges that end S1 sleep are timestamped with the wake-up time (see
+    // wake_stamp). Waking up from S2 takes too long for that, so do not go
+    // beyond S1 while waiting for radio interrupts, and only keep the fast
+    // clock if the radio driver needs its interrupts serviced right away
+    // (FIFO, CAD to RX switch).
+    int level = (mask & HAL_IRQMASK_FAST) ? HAL_SLEEP_S0 :
+        (mask != 0) ? HAL_SLEEP_S1 : -1;
+    if (prevlevel != level) {
+        if (level >= 0) {
+            hal_setMaxSleep(level);
         }
-        prevmask = mask;
+        if (prevlevel >= 0) {
+            hal_clearMaxSleep(prevlevel);
+        }
+        prevlevel = level;
     }
 }
 
@@ -962,6 +1142,9 @@ void hal_rtstats_collect (hal_rtstats* stats) {
         stats->sleep_ticks[i] = HAL.rtstats.sleep[i];
         HAL.rtstats.sleep[i] = 0;
     }
+    stats->dio_stamps = HAL.rtstats.diostamps;
+    stats->dio_stamp_err = HAL.rtstats.diostamperr;
+    HAL.rtstats.diostamps = HAL.rtstats.diostamperr = 0;
 }
 #endif
 
@@ -1079,6 +1262,11 @@ const irqdef HAL_irqdefs[] = {
     { EXTI4_15_IRQn, EXTI_IRQHandler },
 
     { LPTIM1_IRQn, time_irq },
+    { TIM22_IRQn, tcall_irq },
+
+#if defined(PERIPH_ADC)
+    { DMA1_Channel1_IRQn, adc_dma_irq },
+#endif
 
 #if defined(BRD_I2C)
 #if BRD_I2C == 1
@@ -1092,6 +1280,7 @@ const irqdef HAL_irqdefs[] = {
 #elif BRD_USART == BRD_LPUART(1)
     { LPUART1_IRQn, usart_irq },
 #endif
+    { DMA1_Channel2_3_IRQn, usart_dma_irq },
 #endif
 
 #if defined(BRD_PWM_TIM)
@@ -1191,6 +1380,8 @@ void hal_fwinfo (hal_fwi* fwi) {
     fwi->version = fwhdr.version;
     fwi->crc = fwhdr.boot.crc;
     fwi->flashsz = FLASH_SZ;
+    fwi->base = (const void*) &fwhdr;
+    fwi->size = fwhdr.boot.size;
 }
 
 u4_t hal_unique (void) {
@@ -35,9 +35,29 @@ void hal_clearMaxSleep (unsigned int level);
 typedef struct {
     uint32_t run_ticks;
     uint32_t sleep_ticks[HAL_SLEEP_CNT];
+    uint32_t dio_stamps;    // DIO wake-ups timestamped by both wake-up time and TIM22 capture
+    uint32_t dio_stamp_err; // max. deviation of these wake-up times from the capture (ticks)
 } hal_rtstats;
 
 void hal_rtstats_collect (hal_rtstats* stats);
+
+// EEPROM regions (see hw.h)
+enum {
+    EEPROM_R_BOOT,
+    EEPROM_R_STACK,
+    EEPROM_R_PERSO,
+    EEPROM_R_APP,
+
+    EEPROM_R_CNT
+};
+
+typedef struct {
+    uint32_t writes[EEPROM_R_CNT];  // words programmed
+    uint32_t erases[EEPROM_R_CNT];  // words programmed over non-zero content (with erase cycle)
+    uint32_t skips[EEPROM_R_CNT];   // unchanged words (not programmed)
+} eeprom_rtstats;
+
+void eeprom_rtstats_collect (eeprom_rtstats* stats);
 #endif
 
 
@@ -62,9 +82,12 @@ bool pd_verify (void);
 
 void usart_init (void);
 void usart_irq (void);
+void usart_dma_irq (void);
 
 void i2c_irq (void);
 
+void adc_dma_irq (void);
+
 #if defined(SVC_fuota)
 // Glue for FUOTA (fountain code) service
 
@@ -220,9 +220,13 @@ int gpio_transition (int port, int pin, int type, int duration, unsigned int con
 #if (BRD_USART & BRD_LPUART(0)) == 0
 #define USART_BR_9600   0xd05
 #define USART_BR_115200 0x116
+#define USART_BR_LSE    0
 #else
 #define USART_BR_9600   0xd0555
 #define USART_BR_115200 0x115c7
+// LPUART clocked from LSE keeps receiving in Stop mode (max 9600 baud)
+#define USART_BR_LSE    (1u << 31)
+#define USART_BR_9600_LSE (USART_BR_LSE | 0x369)
 #endif
 
 
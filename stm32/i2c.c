@@ -12,16 +12,22 @@
 #define I2Cx_enable()   do { RCC->APB1ENR |= RCC_APB1ENR_I2C1EN; } while (0)
 #define I2Cx_disable()  do { RCC->APB1ENR &= ~RCC_APB1ENR_I2C1EN; } while (0)
 #define I2Cx_IRQn       I2C1_IRQn
+#define I2Cx_DMA_REQ    6 // DMA request for channel 6 (tx) and 7 (rx)
 #else
 #error "Unsupported I2C peripheral"
 #endif
 
+// transaction queue
 static struct {
-    unsigned int wlen;
-    unsigned char* wptr;
-    unsigned int rlen;
-    unsigned char* rptr;
-    osjob_t* job;
+    i2c_txn* head;              // current transaction (NULL: idle)
+    i2c_txn* tail;
+    unsigned int phase;         // next phase of current transaction (0=write, 1=read, 2=stop)
+    int status;                 // status of current transaction (after stop condition)
+} q;
+
+// state of single transaction via i2c_xfer_ex()
+static struct {
+    i2c_txn txn;
     osjobcb_t cb;
     int* pstatus;
 } xfr;
@@ -32,104 +38,182 @@ static struct {
     i2c_cb cb;
 } xfr2;
 
-static void i2c_stop (int status) {
-    // generate stop condition
-    I2Cx->CR2 |= I2C_CR2_STOP;
-    // disable interrupts in NVIC
-    NVIC_DisableIRQ(I2Cx_IRQn);
-    // disable interrupts/peripheral
-    I2Cx->CR1 = 0;
-    // reconfigure GPIOs
-    CFG_PIN_DEFAULT(GPIO_I2C_SCL);
-    CFG_PIN_DEFAULT(GPIO_I2C_SDA);
-    // disable peripheral clock
-    I2Cx_disable();
-    // schedule callback
-    *(xfr.pstatus) = status;
-    if (xfr.job != NULL) {
-        os_setCallback(xfr.job, xfr.cb);
-    } else {
-        xfr.cb(NULL);
-    }
-    // re-enable sleep
-    hal_clearMaxSleep(HAL_SLEEP_S0);
-}
-
-static void i2c_start (int addr) {
+static void i2c_start (void) {
     // enable peripheral clock
     I2Cx_enable();
     // set timing
     I2Cx->TIMINGR = 0x40101A22; // from CubeMX tool; t_rise=t_fall=50ns, 100kHz
     // start I2C
     I2Cx->CR1 |= I2C_CR1_PE;
-    // setup slave address
-    I2Cx->CR2 = (I2Cx->CR2 & ~I2C_CR2_SADD) | (addr & I2C_CR2_SADD);
     // setup GPIOs
     CFG_PIN_AF(GPIO_I2C_SCL, GPIOCFG_OSPEED_40MHz | GPIOCFG_OTYPE_OPEN | GPIOCFG_PUPD_NONE);
     CFG_PIN_AF(GPIO_I2C_SDA, GPIOCFG_OSPEED_40MHz | GPIOCFG_OTYPE_OPEN | GPIOCFG_PUPD_NONE);
+    // setup DMA channels 6 (TXDR) and 7 (RXDR)
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~(DMA_CSELR_C6S | DMA_CSELR_C7S))
+        | (I2Cx_DMA_REQ << 20) | (I2Cx_DMA_REQ << 24);
+    DMA1_Channel6->CPAR = (uint32_t) &I2Cx->TXDR;
+    DMA1_Channel7->CPAR = (uint32_t) &I2Cx->RXDR;
     // disable sleep (keep clock at full speed during transfer
     hal_setMaxSleep(HAL_SLEEP_S0);
     // enable interrupts in NVIC
     NVIC_EnableIRQ(I2Cx_IRQn);
 }
 
+static void i2c_shutdown (void) {
+    // disable interrupts in NVIC
+    NVIC_DisableIRQ(I2Cx_IRQn);
+    // disable DMA channels
+    DMA1_Channel6->CCR = 0;
+    DMA1_Channel7->CCR = 0;
+    // disable interrupts/peripheral
+    I2Cx->CR1 = 0;
+    // reconfigure GPIOs
+    CFG_PIN_DEFAULT(GPIO_I2C_SCL);
+    CFG_PIN_DEFAULT(GPIO_I2C_SDA);
+    // disable peripheral clock
+    I2Cx_disable();
+    // re-enable sleep
+    hal_clearMaxSleep(HAL_SLEEP_S0);
+}
+
+// report completion of transaction
+static void i2c_done (i2c_txn* t, int status) {
+    t->status = status;
+    if (t->job != NULL) {
+        os_setCallback(t->job, t->cb);
+    } else if (t->cb != NULL) {
+        t->cb(NULL);
+    }
+}
+
+// start write phase, read phase (with repeated start), or end transaction
 static void i2c_cont (void) {
-    if (xfr.wlen) {
-        // calculate length; TODO: handle >255
-        int n = xfr.wlen & 0xff;
-        xfr.wlen -= n;
-        // set direction & number of bytes
-        I2Cx->CR2 = (I2Cx->CR2 & ~(I2C_CR2_RD_WRN | I2C_CR2_NBYTES)) | (n << 16);
+    i2c_txn* t = q.head;
+    if (q.phase == 0 && t->wlen) {
+        q.phase = 1;
+        // set direction & number of bytes, TXDR is fed by DMA
+        DMA1_Channel6->CCR = 0;
+        DMA1_Channel6->CMAR = (uint32_t) t->wbuf;
+        DMA1_Channel6->CNDTR = t->wlen;
+        DMA1_Channel6->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_EN;
+        I2Cx->CR2 = (I2Cx->CR2 & ~(I2C_CR2_RD_WRN | I2C_CR2_NBYTES)) | (t->wlen << 16);
         // enable interrupts
-        I2Cx->CR1 = (I2Cx->CR1 & ~0xfe) | I2C_CR1_TXIE | I2C_CR1_TCIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE;
+        I2Cx->CR1 = (I2Cx->CR1 & ~0xfe) | I2C_CR1_TXDMAEN | I2C_CR1_TCIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE;
         // start TX
         I2Cx->CR2 |= I2C_CR2_START;
-    } else if (xfr.rlen) {
-        // calculate length; TODO: handle >255
-        int n = xfr.rlen & 0xff;
-        xfr.rlen -= n;
-        // set direction & number of bytes
-        I2Cx->CR2 = (I2Cx->CR2 & ~(I2C_CR2_RD_WRN | I2C_CR2_NBYTES)) | I2C_CR2_RD_WRN | (n << 16);
+    } else if (q.phase <= 1 && t->rlen) {
+        q.phase = 2;
+        // set direction & number of bytes, RXDR is drained by DMA
+        DMA1_Channel7->CCR = 0;
+        DMA1_Channel7->CMAR = (uint32_t) t->rbuf;
+        DMA1_Channel7->CNDTR = t->rlen;
+        DMA1_Channel7->CCR = DMA_CCR_MINC | DMA_CCR_EN;
+        I2Cx->CR2 = (I2Cx->CR2 & ~(I2C_CR2_RD_WRN | I2C_CR2_NBYTES)) | I2C_CR2_RD_WRN | (t->rlen << 16);
         // enable interrupts
-        I2Cx->CR1 = (I2Cx->CR1 & ~0xfe) | I2C_CR1_RXIE | I2C_CR1_TCIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE;
+        I2Cx->CR1 = (I2Cx->CR1 & ~0xfe) | I2C_CR1_RXDMAEN | I2C_CR1_TCIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE;
         // start RX
         I2Cx->CR2 |= I2C_CR2_START;
     } else {
-        // done
-        i2c_stop(I2C_OK);
+        // done, generate stop condition (completion on STOPF)
+        q.status = I2C_OK;
+        I2Cx->CR1 = (I2Cx->CR1 & ~0xfe) | I2C_CR1_STOPIE | I2C_CR1_ERRIE;
+        I2Cx->CR2 |= I2C_CR2_STOP;
     }
 }
 
+// start transaction at head of queue
+static void i2c_begin (void) {
+    i2c_txn* t = q.head;
+    if (t->wlen == 0 && t->rlen == 0) {
+        // nothing to transfer
+        q.head = t->next;
+        i2c_done(t, I2C_OK);
+        if (q.head == NULL) {
+            i2c_shutdown();
+        } else {
+            i2c_begin();
+        }
+        return;
+    }
+    // setup slave address
+    I2Cx->CR2 = (I2Cx->CR2 & ~I2C_CR2_SADD) | (t->addr & I2C_CR2_SADD);
+    q.phase = 0;
+    i2c_cont();
+}
+
 void i2c_irq (void) {
     unsigned int isr = I2Cx->ISR;
-    if (isr & I2C_ISR_NACKF) {
-        // NACK detected, transfer failed!
-        i2c_stop(I2C_NAK);
+    if (isr & (I2C_ISR_BERR | I2C_ISR_ARLO)) {
+        // bus error or arbitration lost
+        I2Cx->ICR = I2C_ICR_BERRCF | I2C_ICR_ARLOCF;
+        i2c_abort();
+    } else if (isr & I2C_ISR_NACKF) {
+        // NACK detected, transfer failed! (stop condition is generated automatically)
+        I2Cx->ICR = I2C_ICR_NACKCF;
+        DMA1_Channel6->CCR = 0;
+        DMA1_Channel7->CCR = 0;
+        q.status = I2C_NAK;
+        I2Cx->CR1 = (I2Cx->CR1 & ~0xfe) | I2C_CR1_STOPIE | I2C_CR1_ERRIE;
+    } else if (isr & I2C_ISR_STOPF) {
+        // transaction complete, move on to next one
+        I2Cx->ICR = I2C_ICR_STOPCF;
+        i2c_txn* t = q.head;
+        q.head = t->next;
+        i2c_done(t, q.status);
+        if (q.head == NULL) {
+            i2c_shutdown();
+        } else {
+            i2c_begin();
+        }
     } else if (isr & I2C_ISR_TC) {
-        // transfer complete, move on
+        // transfer complete (wait for DMA to fetch last byte), move on
+        while (DMA1_Channel7->CNDTR != 0 && (DMA1_Channel7->CCR & DMA_CCR_EN));
         i2c_cont();
-    } else if (isr & I2C_ISR_TXIS) {
-        // write next byte
-        I2Cx->TXDR = *xfr.wptr++;
-    } else if (isr & I2C_ISR_RXNE) {
-        // next byte received
-        *xfr.rptr++ = I2Cx->RXDR;
     } else {
         hal_failed(); // XXX
     }
 }
 
+void i2c_queue (i2c_txn* t) {
+    ASSERT(t->wlen <= 255 && t->rlen <= 255);
+    hal_disableIRQs();
+    for (i2c_txn* p = q.head; p != NULL; p = p->next) {
+        ASSERT(p != t); // already queued
+    }
+    t->next = NULL;
+    t->status = I2C_BUSY;
+    if (q.head == NULL) {
+        q.head = q.tail = t;
+        i2c_start();
+        i2c_begin();
+    } else {
+        q.tail->next = t;
+        q.tail = t;
+    }
+    hal_enableIRQs();
+}
+
 static void i2c_timeout (osjob_t* job) {
     i2c_abort();
 }
 
+static void xfr_done (osjob_t* job) {
+    *xfr.pstatus = xfr.txn.status;
+    xfr.cb(job);
+}
+
 void i2c_xfer_ex (unsigned int addr, unsigned char* buf, unsigned int wlen, unsigned int rlen, ostime_t timeout,
         osjob_t* job, osjobcb_t cb, int* pstatus) {
-    // setup xfr structure
-    xfr.wlen = wlen;
-    xfr.rlen = rlen;
-    xfr.wptr = xfr.rptr = buf;
-    xfr.job = job;
+    // only one transfer at a time (the transaction is static)
+    ASSERT(xfr.txn.status != I2C_BUSY);
+    // setup transaction
+    xfr.txn.addr = addr;
+    xfr.txn.wbuf = xfr.txn.rbuf = buf;
+    xfr.txn.wlen = wlen;
+    xfr.txn.rlen = rlen;
+    xfr.txn.job = job;
+    xfr.txn.cb = xfr_done;
     xfr.cb = cb;
     xfr.pstatus = pstatus;
     *xfr.pstatus = I2C_BUSY;
@@ -137,10 +221,8 @@ void i2c_xfer_ex (unsigned int addr, unsigned char* buf, unsigned int wlen, unsi
     if (timeout) {
         os_setTimedCallback(job, os_getTime() + timeout, i2c_timeout);
     }
-    // prepare peripheral
-    i2c_start(addr);
     // start actual transfer
-    i2c_cont();
+    i2c_queue(&xfr.txn);
 }
 
 static void i2cfunc (osjob_t* j) {
@@ -154,7 +236,19 @@ void i2c_xfer (unsigned int addr, unsigned char* buf, unsigned int wlen, unsigne
 
 void i2c_abort (void) {
     hal_disableIRQs();
-    i2c_stop(I2C_ABORT);
+    if (q.head != NULL) {
+        // generate stop condition
+        I2Cx->CR2 |= I2C_CR2_STOP;
+        i2c_shutdown();
+        // fail current and all queued transactions
+        i2c_txn* t = q.head;
+        q.head = NULL;
+        while (t != NULL) {
+            i2c_txn* next = t->next;
+            i2c_done(t, I2C_ABORT);
+            t = next;
+        }
+    }
     hal_enableIRQs();
 }
 
@@ -12,11 +12,13 @@
 #define USARTx_enable()         do { RCC->APB2ENR |= RCC_APB2ENR_USART1EN; } while (0)
 #define USARTx_disable()        do { RCC->APB2ENR &= ~RCC_APB2ENR_USART1EN; } while (0)
 #define USARTx_IRQn             USART1_IRQn
+#define USARTx_DMA_REQ          3 // DMA request for channel 2 (tx) and 3 (rx)
 #elif BRD_USART == BRD_LPUART(1)
 #define USARTx                  LPUART1
 #define USARTx_enable()         do { RCC->APB1ENR |= RCC_APB1ENR_LPUART1EN; } while (0)
 #define USARTx_disable()        do { RCC->APB1ENR &= ~RCC_APB1ENR_LPUART1EN; } while (0)
 #define USARTx_IRQn             LPUART1_IRQn
+#define USARTx_DMA_REQ          5 // DMA request for channel 2 (tx) and 3 (rx)
 #endif
 
 enum {
@@ -34,17 +36,44 @@ static struct {
 
     usart_tx_func tx;
     void* txarg;
+
+    unsigned int lse;           // LPUART clocked from LSE (keeps receiving in Stop mode)
+    unsigned int rxactive;      // frame reception in progress (LSE, sleep restricted to S1)
+
+    struct {
+        unsigned char* buf;     // ring buffer (NULL: no DMA reception)
+        unsigned int size;
+        unsigned int rpos;      // read position
+        osjob_t* job;
+        osjobcb_t cb;
+    } dmarx;
+
+    struct {
+        osjob_t* job;           // (NULL: no DMA transmission)
+        osjobcb_t cb;
+    } dmatx;
 } usart;
 
 static void usart_on (unsigned int flag) {
     hal_disableIRQs();
     if (usart.on == 0) {
-        // disable sleep (keep clock at full speed during transfer
-        hal_setMaxSleep(HAL_SLEEP_S0);
+#if BRD_USART == BRD_LPUART(1)
+        usart.lse = (usart.br & USART_BR_LSE) != 0;
+        // select kernel clock: LSE or PCLK1
+        RCC->CCIPR = (RCC->CCIPR & ~RCC_CCIPR_LPUART1SEL) | (usart.lse ? RCC_CCIPR_LPUART1SEL : 0);
+#endif
+        if (!usart.lse) {
+            // disable sleep (keep clock at full speed during transfer
+            hal_setMaxSleep(HAL_SLEEP_S0);
+        }
         // enable peripheral clock
         USARTx_enable();
         // set baudrate
-        USARTx->BRR = usart.br;
+        USARTx->BRR = usart.br & ~USART_BR_LSE;
+#if BRD_USART == BRD_LPUART(1)
+        // wake-up from Stop mode on start bit (must be set before enable)
+        USARTx->CR3 = usart.lse ? USART_CR3_WUS_1 : 0;
+#endif
         // usart enable
         USARTx->CR1 = USART_CR1_UE;
         // enable interrupts in NVIC
@@ -60,16 +89,32 @@ static void usart_off (unsigned int flag) {
     if (usart.on == 0) {
         // disable USART
         USARTx->CR1 = 0;
+        USARTx->CR3 = 0;
         // disable peripheral clock
         USARTx_disable();
         // disable interrupts in NVIC
         NVIC_DisableIRQ(USARTx_IRQn);
         // re-enable sleep
-        hal_clearMaxSleep(HAL_SLEEP_S0);
+        if (!usart.lse) {
+            hal_clearMaxSleep(HAL_SLEEP_S0);
+        }
     }
     hal_enableIRQs();
 }
 
+// track reception of a frame when clocked from LSE: wake-up from Stop mode happens on
+// the start bit, stay in S1 (DMA and interrupts serviced) until the line becomes idle
+static void rx_active (unsigned int active) {
+    if (usart.rxactive != active) {
+        usart.rxactive = active;
+        if (active) {
+            hal_setMaxSleep(HAL_SLEEP_S1);
+        } else {
+            hal_clearMaxSleep(HAL_SLEEP_S1);
+        }
+    }
+}
+
 static void rx_on (unsigned int noirq) {
     // turn on usart
     usart_on(RX_ON);
@@ -78,10 +123,24 @@ static void rx_on (unsigned int noirq) {
     // setup I/O line
     CFG_PIN_AF(GPIO_USART_RX, GPIOCFG_OSPEED_40MHz | GPIOCFG_OTYPE_PUPD | GPIOCFG_PUPD_NONE);
     if (noirq == 0) {
-        // flush data, clear ORE and enable receive interrupt
+        // flush data, clear ORE and enable receive (or idle line) interrupt
         USARTx->RQR |= USART_RQR_RXFRQ;
         USARTx->ICR |= USART_ISR_ORE;
-        USARTx->CR1 |= USART_CR1_RXNEIE;
+        if (usart.dmarx.buf) {
+            // bytes are transferred by DMA, notify at end of frame
+            USARTx->CR3 |= USART_CR3_DMAR;
+            USARTx->CR1 |= USART_CR1_IDLEIE;
+        } else {
+            USARTx->CR1 |= USART_CR1_RXNEIE;
+        }
+#if BRD_USART == BRD_LPUART(1)
+        if (usart.lse) {
+            // wake-up from Stop mode on start bit (via EXTI line 28)
+            USARTx->CR3 |= USART_CR3_WUFIE;
+            USARTx->CR1 |= USART_CR1_UESM | USART_CR1_IDLEIE;
+            EXTI->IMR |= EXTI_IMR_IM28;
+        }
+#endif
     }
 }
 
@@ -89,20 +148,40 @@ static void rx_off (void) {
     // deconfigure I/O line
     CFG_PIN_DEFAULT(GPIO_USART_RX);
     // disable receiver and interrupts
-    USARTx->CR1 &= ~(USART_CR1_RE | USART_CR1_RXNEIE);
+    USARTx->CR1 &= ~(USART_CR1_RE | USART_CR1_RXNEIE | USART_CR1_IDLEIE | USART_CR1_UESM);
+    USARTx->CR3 &= ~(USART_CR3_DMAR | USART_CR3_WUFIE);
+#if BRD_USART == BRD_LPUART(1)
+    EXTI->IMR &= ~EXTI_IMR_IM28;
+#endif
+    // disable DMA channel 3
+    if (usart.dmarx.buf) {
+        DMA1_Channel3->CCR = 0;
+        DMA1->IFCR = DMA_IFCR_CGIF3;
+        usart.dmarx.buf = NULL;
+    }
+    rx_active(0);
     // turn off usart
     usart_off(RX_ON);
 }
 
-static void tx_on (void) {
+static void tx_on (unsigned int dma) {
     // turn on usart
     usart_on(TX_ON);
+    if (usart.lse) {
+        // transmitter is fed by interrupts or DMA, which are not serviced in Stop mode
+        hal_setMaxSleep(HAL_SLEEP_S1);
+    }
     // enable transmitter
     USARTx->CR1 |= USART_CR1_TE;
     // setup I/O line
     CFG_PIN_AF(GPIO_USART_TX, GPIOCFG_OSPEED_40MHz | GPIOCFG_OTYPE_PUPD | GPIOCFG_PUPD_NONE);
-    // enable interrupt
-    USARTx->CR1 |= USART_CR1_TXEIE;
+    if (dma) {
+        // enable DMA requests (completion via DMA interrupt)
+        USARTx->CR3 |= USART_CR3_DMAT;
+    } else {
+        // enable interrupt
+        USARTx->CR1 |= USART_CR1_TXEIE;
+    }
 }
 
 static void tx_off (void) {
@@ -110,6 +189,10 @@ static void tx_off (void) {
     CFG_PIN(GPIO_USART_TX, GPIOCFG_MODE_INP | GPIOCFG_OSPEED_400kHz | GPIOCFG_OTYPE_OPEN | GPIOCFG_PUPD_PUP);
     // disable receiver and interrupts
     USARTx->CR1 &= ~(USART_CR1_TE | USART_CR1_TXEIE);
+    USARTx->CR3 &= ~USART_CR3_DMAT;
+    if (usart.lse) {
+        hal_clearMaxSleep(HAL_SLEEP_S1);
+    }
     // turn off usart
     usart_off(TX_ON);
 }
@@ -133,8 +216,11 @@ void usart_recv (usart_rx_func rx, void* arg) {
 void usart_abort_recv (void) {
     hal_disableIRQs();
     if (usart.on & RX_ON) {
+        bool dma = (usart.dmarx.buf != NULL);
         rx_off();
-        usart.rx(USART_ERROR, usart.rxarg);
+        if (!dma) {
+            usart.rx(USART_ERROR, usart.rxarg);
+        }
     }
     hal_enableIRQs();
 }
@@ -142,12 +228,93 @@ void usart_abort_recv (void) {
 void usart_send (usart_tx_func tx, void* arg) {
     usart.tx = tx;
     usart.txarg = arg;
-    tx_on();
+    tx_on(0);
+}
+
+void usart_recv_dma (unsigned char* ring, unsigned int size, osjob_t* job, osjobcb_t cb) {
+    ASSERT(size > 0 && size <= 0xffff);
+    usart.dmarx.buf = ring;
+    usart.dmarx.size = size;
+    usart.dmarx.rpos = 0;
+    usart.dmarx.job = job;
+    usart.dmarx.cb = cb;
+    // DMA channel 3: RDR to ring buffer (circular), interrupt at half and full buffer
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~DMA_CSELR_C3S) | (USARTx_DMA_REQ << 8);
+    DMA1_Channel3->CPAR = (uint32_t) &USARTx->RDR;
+    DMA1_Channel3->CMAR = (uint32_t) ring;
+    DMA1_Channel3->CNDTR = size;
+    DMA1_Channel3->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_EN;
+    NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+    // (ring buffer must be drained by consumer, old data is overwritten)
+    rx_on(0);
+}
+
+unsigned int usart_read (unsigned char* dst, unsigned int len) {
+    hal_disableIRQs();
+    unsigned int wpos = usart.dmarx.buf ? usart.dmarx.size - DMA1_Channel3->CNDTR : usart.dmarx.rpos;
+    hal_enableIRQs();
+    unsigned int n = 0;
+    while (n < len && usart.dmarx.rpos != wpos) {
+        dst[n++] = usart.dmarx.buf[usart.dmarx.rpos++];
+        if (usart.dmarx.rpos == usart.dmarx.size) {
+            usart.dmarx.rpos = 0;
+        }
+    }
+    return n;
+}
+
+void usart_send_dma (const unsigned char* buf, unsigned int len, osjob_t* job, osjobcb_t cb) {
+    ASSERT(len > 0 && len <= 0xffff);
+    usart.dmatx.job = job;
+    usart.dmatx.cb = cb;
+    // DMA channel 2: buffer to TDR
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~DMA_CSELR_C2S) | (USARTx_DMA_REQ << 4);
+    DMA1_Channel2->CPAR = (uint32_t) &USARTx->TDR;
+    DMA1_Channel2->CMAR = (uint32_t) buf;
+    DMA1_Channel2->CNDTR = len;
+    DMA1_Channel2->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE | DMA_CCR_EN;
+    NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+    tx_on(1);
+}
+
+void usart_dma_irq (void) {
+    unsigned int isr = DMA1->ISR;
+    if (isr & (DMA_ISR_HTIF3 | DMA_ISR_TCIF3)) {
+        DMA1->IFCR = DMA_IFCR_CHTIF3 | DMA_IFCR_CTCIF3;
+        // half or full ring buffer - let consumer drain it
+        if (usart.dmarx.buf) {
+            os_setCallback(usart.dmarx.job, usart.dmarx.cb);
+        }
+    }
+    if (isr & DMA_ISR_TCIF2) {
+        DMA1->IFCR = DMA_IFCR_CGIF2;
+        DMA1_Channel2->CCR = 0;
+        // last byte written, wait until it has been shifted out
+        USARTx->ICR = USART_ICR_TCCF;
+        USARTx->CR1 |= USART_CR1_TCIE;
+    }
 }
 
 void usart_irq (void) {
     unsigned int isr = USARTx->ISR;
     unsigned int cr1 = USARTx->CR1;
+#if BRD_USART == BRD_LPUART(1)
+    if ((USARTx->CR3 & USART_CR3_WUFIE) && (isr & USART_ISR_WUF)) {
+        // start bit detected (woken up from Stop mode)
+        USARTx->ICR = USART_ICR_WUCF;
+        rx_active(1);
+    }
+#endif
+    if ((cr1 & USART_CR1_IDLEIE) && (isr & USART_ISR_IDLE)) {
+        // end of frame
+        USARTx->ICR = USART_ICR_IDLECF | USART_ICR_ORECF;
+        rx_active(0);
+        if (usart.dmarx.buf) {
+            os_setCallback(usart.dmarx.job, usart.dmarx.cb);
+        }
+    }
     if (cr1 & USART_CR1_RXNEIE) {
         if (isr & USART_ISR_ORE) {
             USARTx->ICR |= USART_ISR_ORE;
@@ -172,7 +339,12 @@ void usart_irq (void) {
     if ((cr1 & USART_CR1_TCIE) && (isr & USART_ISR_TC)) {
         USARTx->CR1 &= ~USART_CR1_TCIE;
         tx_off();
-        usart.tx(USART_DONE, usart.txarg);
+        if (usart.dmatx.job) {
+            os_setCallback(usart.dmatx.job, usart.dmatx.cb);
+            usart.dmatx.job = NULL;
+        } else {
+            usart.tx(USART_DONE, usart.txarg);
+        }
     }
 }
 
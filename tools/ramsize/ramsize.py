@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+
+# Copyright (C) 2016-2019 Semtech (International) AG. All rights reserved.
+#
+# This file is subject to the terms and conditions defined in file 'LICENSE',
+# which is part of this source code package.
+
+# Report member sizes, offsets and padding holes of C structures from the
+# debug information of an ELF file (as dumped by objdump), and check the
+# size of the structures against a budget. Optionally list the sizes of
+# data symbols (e.g. region tables).
+
+import re
+import subprocess
+import sys
+
+from argparse import ArgumentParser
+from typing import Dict,List,Optional,Tuple
+
+class Die:
+    def __init__(self, off:int, depth:int, tag:str) -> None:
+        self.off = off
+        self.depth = depth
+        self.tag = tag
+        self.attrs:Dict[str,str] = {}
+        self.children:List['Die'] = []
+
+    def name(self) -> Optional[str]:
+        return self.attrs.get('DW_AT_name')
+
+    def int(self, attr:str) -> Optional[int]:
+        v = self.attrs.get(attr)
+        if v is None:
+            return None
+        m = re.search(r'DW_OP_plus_uconst: (\d+)', v)
+        if m:
+            return int(m.group(1))
+        m = re.match(r'^(0x[0-9a-f]+|\d+)$', v)
+        return int(m.group(1), 0) if m else None
+
+    def ref(self, attr:str) -> Optional[int]:
+        m = re.match(r'^<(0x[0-9a-f]+)>$', self.attrs.get(attr, ''))
+        return int(m.group(1), 16) if m else None
+
+RE_DIE  = re.compile(r'^\s*<(\d+)><([0-9a-f]+)>: Abbrev Number: \d+ \((\w+)\)')
+RE_ATTR = re.compile(r'^\s*<[0-9a-f]+>\s+(DW_AT_\w+)\s*:\s*(.*)$')
+
+def parse(lines:List[str]) -> Dict[int,Die]:
+    dies:Dict[int,Die] = {}
+    stack:List[Die] = []
+    die = None
+    for l in lines:
+        m = RE_DIE.match(l)
+        if m:
+            depth, off = int(m.group(1)), int(m.group(2), 16)
+            die = Die(off, depth, m.group(3))
+            dies[off] = die
+            del stack[depth:]
+            if stack:
+                stack[-1].children.append(die)
+            stack.append(die)
+            continue
+        m = RE_ATTR.match(l)
+        if m and die:
+            # strip form annotation, e.g. "(indirect string, offset: 0x6a): name"
+            die.attrs[m.group(1)] = re.sub(r'^\([^)]*\):\s*', '', m.group(2).strip())
+    return dies
+
+class Layout:
+    def __init__(self, dies:Dict[int,Die]) -> None:
+        self.dies = dies
+
+    def find(self, name:str) -> Optional[Die]:
+        for d in self.dies.values():
+            if d.name() == name and d.tag in ('DW_TAG_structure_type', 'DW_TAG_union_type') \
+                    and d.int('DW_AT_byte_size') is not None:
+                return d
+            if d.name() == name and d.tag == 'DW_TAG_typedef':
+                t = self.resolve(d)
+                if t and t.tag in ('DW_TAG_structure_type', 'DW_TAG_union_type'):
+                    return t
+        return None
+
+    def resolve(self, d:Die) -> Optional[Die]:
+        while d.tag in ('DW_TAG_typedef', 'DW_TAG_const_type', 'DW_TAG_volatile_type', 'DW_TAG_member'):
+            r = d.ref('DW_AT_type')
+            if r is None:
+                return None
+            d = self.dies[r]
+        return d
+
+    def size(self, d:Die) -> int:
+        t = self.resolve(d)
+        if t is None:
+            return 0
+        if t.tag == 'DW_TAG_array_type':
+            n = 1
+            for sr in t.children:
+                if sr.tag == 'DW_TAG_subrange_type':
+                    c = sr.int('DW_AT_count')
+                    ub = sr.int('DW_AT_upper_bound')
+                    n *= c if c is not None else (ub + 1 if ub is not None else 0)
+            return n * self.size(self.dies[t.ref('DW_AT_type')])
+        return t.int('DW_AT_byte_size') or 0
+
+    def members(self, s:Die) -> List[Tuple[int,int,str]]:
+        ml = []
+        for m in s.children:
+            if m.tag != 'DW_TAG_member':
+                continue
+            name = m.name() or '<anonymous %s>' % self.resolve(m).tag[7:-5]
+            bits = m.int('DW_AT_bit_size')
+            if bits is not None:
+                boff = m.int('DW_AT_data_bit_offset')
+                if boff is None:
+                    boff = (m.int('DW_AT_data_member_location') or 0) * 8
+                ml.append((boff // 8, (boff % 8 + bits + 7) // 8, '%s:%d' % (name, bits)))
+            else:
+                ml.append((m.int('DW_AT_data_member_location') or 0, self.size(m), name))
+        return ml
+
+def report(lo:Layout, s:Die, name:str) -> int:
+    size = s.int('DW_AT_byte_size')
+    print('%s %s: %d bytes' % (s.tag[7:-5], name, size))
+    print('%8s %6s %6s  %s' % ('offset', 'size', 'hole', 'member'))
+    end = holes = 0
+    for (off, sz, mname) in lo.members(s):
+        hole = off - end if off > end and s.tag == 'DW_TAG_structure_type' else 0
+        holes += hole
+        print('%8d %6d %6s  %s' % (off, sz, hole or '', mname))
+        end = max(end, off + sz)
+    if s.tag == 'DW_TAG_structure_type' and size > end:
+        holes += size - end
+        print('%8d %6s %6d  <tail padding>' % (end, '', size - end))
+    print('%8s %6d %6d  total (%d bytes padding)' % ('', size, holes, holes))
+    return size
+
+def symbols(lines:List[str], pattern:str) -> None:
+    # e.g. "08001234 l     O .rodata.REGIONS\t000000b0 REGIONS"
+    syms = {}
+    for l in lines:
+        left, tab, right = l.partition('\t')
+        f = right.split()
+        if tab and len(f) == 2 and ' O ' in left and re.search(pattern, f[1]):
+            syms[f[1]] = int(f[0], 16)
+    print('%8s  %s' % ('size', 'symbol'))
+    for name in sorted(syms):
+        print('%8d  %s' % (syms[name], name))
+    print('%8d  total' % sum(syms.values()))
+    print()
+
+def main() -> None:
+    p = ArgumentParser(description='Report structure layout and check RAM budget')
+    p.add_argument('elf', help='ELF file (object or executable) with debug information')
+    p.add_argument('-s', '--struct', action='append',
+            help='structure to report (default: lmic_t), STRUCT=BUDGET checks size against budget')
+    p.add_argument('-y', '--symbols', metavar='REGEX',
+            help='list sizes of data objects with matching names')
+    p.add_argument('--objdump', default='objdump', help='objdump executable')
+    args = p.parse_args()
+
+    def objdump(opt:str) -> List[str]:
+        return subprocess.run([args.objdump, opt, args.elf],
+                stdout=subprocess.PIPE, universal_newlines=True, check=True).stdout.splitlines()
+
+    if args.symbols:
+        symbols(objdump('-t'), args.symbols)
+    lo = Layout(parse(objdump('--dwarf=info')))
+
+    # structures in order of first mention, last budget given wins
+    structs:Dict[str,str] = {}
+    for sarg in (args.struct or ['lmic_t']):
+        name, _, budget = sarg.partition('=')
+        structs[name] = budget or structs.get(name, '')
+
+    over = []
+    for name, budget in structs.items():
+        s = lo.find(name)
+        if s is None:
+            sys.exit('%s: structure %s not found' % (args.elf, name))
+        size = report(lo, s, name)
+        if budget:
+            print('%8s %6d        budget' % ('', int(budget, 0)))
+            if size > int(budget, 0):
+                over.append('%s: %d bytes over budget' % (name, size - int(budget, 0)))
+        print()
+    if over:
+        sys.exit('\n'.join(over))
+
+if __name__ == '__main__':
+    main()
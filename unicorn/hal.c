@@ -169,6 +169,16 @@ void hal_waitUntil (u4_t time) {
     }
 }
 
+// simulated time only advances in SVC_SLEEP, so wait right away
+void hal_timedCall (u4_t time, void (*func) (void)) {
+    if (func) {
+        hal_disableIRQs();
+        hal_waitUntil(time);
+        func();
+        hal_enableIRQs();
+    }
+}
+
 u1_t hal_getBattLevel (void) {
     return 0;
 }
@@ -320,6 +330,18 @@ static void cad_scan (osjob_t* simjob) {
     }
 }
 
+static void rxcad (void) {
+    hal_waitUntil(LMIC.rxtime); // busy wait until exact rx time
+    // CAD over rx window - only stay in rx if a preamble is in sight
+    if( !svc32(SVC_RX_CAD, LMIC.freq, LMIC.rps, LMIC.rxsyms) ) {
+        cad_nothing();
+    } else {
+        ostime_t timeout = syms2ticks(LMIC.rps, LMIC.rxsyms);
+        svc(SVC_RX_START, LMIC.freq, LMIC.rps, timeout);
+        os_setTimedCallback(&sim.rjob, LMIC.rxtime + timeout, rxdo);
+    }
+}
+
 void os_radio (u1_t mode) {
 #if 0
     if( mode == RADIO_RX || mode == RADIO_RXON ) {
@@ -345,6 +367,14 @@ void os_radio (u1_t mode) {
             LMIC.rssi = -127;
             break;
 
+        case RADIO_CCACAD:
+            LMIC.rssi = svc32(SVC_RX_CAD, LMIC.freq, LMIC.rps, /*symbols*/2) ? CAD_RSSI_BUSY : CAD_RSSI_CLEAR;
+            break;
+
+        case RADIO_RXCAD:
+            rxcad();
+            break;
+
         case RADIO_RXON:
             rxon(&sim.rjob);
             break;
@@ -403,6 +433,8 @@ void hal_fwinfo (hal_fwi* fwi) {
     fwi->version = 0; // XXX no longer in fwhdr
     fwi->crc = fwhdr.crc;
     fwi->flashsz = 128*1024;
+    fwi->base = (const void*) &fwhdr;
+    fwi->size = fwhdr.size;
 }
 
 u4_t hal_unique (void) {
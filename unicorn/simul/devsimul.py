@@ -434,6 +434,9 @@ class Simulation:
         self.irq_invoking = False
 
         self.rxing:bool = False
+        # radio receive time (for energy comparison of RX strategies)
+        self.rxticks = 0
+        self.cadticks = 0
 
         self.pc = self.ipc
         self.emu.reg_write(uca.UC_ARM_REG_SP, self.isp)
@@ -543,6 +546,7 @@ class Simulation:
         self.rxparams['rxbeg'] = self.ticks
         self.rxparams['rxtout'] = params[2]
         self.rxing = True
+        self.rxticks += params[2]
         return True
 
     def svc_rx_on(self, params:Tuple[int,int,int], lr:int) -> int:
@@ -551,6 +555,7 @@ class Simulation:
         self.rxparams['rxbeg'] = self.ticks
         self.rxparams['rxtout'] = params[2]
         self.rxing = True
+        self.rxticks += params[2]
         v = 0
         m = self.medium.get_dn(
             self.rxparams['rxbeg'], self.rxparams['rxtout'],
@@ -565,7 +570,8 @@ class Simulation:
         self.rxparams['freq'] = params[0]
         self.rxparams['rps'] = params[1]
         self.rxparams['rxbeg'] = self.ticks
-        self.rxparams['rxtout'] = LoraMsg.symtime(params[1], params[2])
+        self.rxparams['rxtout'] = Simulation.time2ticks(LoraMsg.symtime(params[1], params[2]))
+        self.cadticks += self.rxparams['rxtout']
         v = 0
         m = self.medium.get_dn(
             self.rxparams['rxbeg'], self.rxparams['rxtout'],